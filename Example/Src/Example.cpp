@@ -10,6 +10,11 @@
 // Author: Aaron Pulver
 // Date: 5/19/14
 //
+// Usage: ./Example [-e threshold] [-E frames,...|none]
+//   -e  confidence a partial window model needs to report a gesture early
+//       (default 0.9)
+//   -E  partial window models to load from Models (default 30,45)
+//
 ////////////////////////////////////////////////////////////////////////
 
 #include "UserTracking.h"
@@ -17,6 +22,10 @@
 #include <XnCppWrapper.h>
 #include <XnPropNames.h>
 #include "GlobalDefs.h"
+#include "../../Src/GesturePipeline.h"
+#include "../../Src/SkeletonSource.h"
+#include <stdlib.h>
+#include <string.h>
 
 /////////////////////////////////////////////////////////////////////////
 // Global Variables
@@ -24,6 +33,13 @@
 xn::Context g_Context;
 xn::UserGenerator g_UserGenerator;
 UserTracking g_UserTracking;
+// The capture thread reads the Kinect while the main thread classifies.
+// Drop old frames rather than stall the sensor if classification falls behind.
+GesturePipeline g_Pipeline(4, GesturePipeline::DROP_OLDEST);
+// Partial window models, if any, report gestures before the 2 s window is full
+EarlyDetector g_EarlyDetector(NOTHING);
+// The cascade's first stage made with TrainCascade, if there is one
+struct svm_model* g_GestureGate = NULL;
 ////////////////////////////////////////////////////////////////////////
 
 // Called when a new user is detected
@@ -36,8 +52,7 @@ User_NewUser(xn::UserGenerator& generator, XnUserID nId, void* pCookie) {
 void XN_CALLBACK_TYPE
 User_LostUser(xn::UserGenerator& generator, XnUserID nId, void* pCookie) {
 	printf("Lost User: %d\n", nId);
-	// see if first user was lost. If so, set flag to exit gracefully
-	g_UserTracking.removeKinectUser(nId);
+	// g_UserTracking drops the user once they are missing from the frames
 }
 
 // Called when callibration was started
@@ -54,7 +69,7 @@ Calibration_End(xn::SkeletonCapability& capability, unsigned int nId,
 	if (status == 0) {
 		printf("User calibrated\n");
 		capability.StartTracking(nId);
-		g_UserTracking.addKinectUser(nId);
+		// g_UserTracking picks the user up from the next tracked frame
 	} else {
 		printf("Failed to calibrate user %d\n", nId);
 		capability.RequestCalibration(nId, TRUE);
@@ -82,7 +97,135 @@ inline const char* GestureToString(Gesture gesture)
 	}
 				}
 
-int main() {
+/**
+ * Loads the partial window models made with PartialWindows that are in
+ * Models (Model.<frames>.txt). Early detections feed the same gesture events
+ * that select the user, so only the longer stages are loaded by default:
+ * with the 15 frame stage too, twice as many gestures were reported wrongly
+ * before they happened (28% against 13% on Data/SampleMerged.txt).
+ * @param stages frames of each stage, comma separated, "none" for no
+ * early detection
+ * @param threshold confidence a stage needs to report a gesture
+ */
+void LoadEarlyModels(const char* stages, double threshold)
+{
+	char list[256];
+	strncpy(list, stages, sizeof(list) - 1);
+	list[sizeof(list) - 1] = '\0';
+	for (char* item = strtok(list, ","); item != NULL; item = strtok(NULL, ",")) {
+		int frames = atoi(item);
+		if (frames <= 0) {
+			continue;
+		}
+		char path[256];
+		sprintf(path, "../../Models/Model.%d.txt", frames);
+		FILE* file = fopen(path, "r");
+		if (file == NULL) {
+			continue;
+		}
+		fclose(file);
+		g_EarlyDetector.AddStage(frames, path, threshold);
+	}
+	if (g_EarlyDetector.GetNumStages() > 0) {
+		printf("Early detection with %d partial window models, threshold %.2f\n", g_EarlyDetector.GetNumStages(), threshold);
+		g_UserTracking.setEarlyDetector(&g_EarlyDetector);
+	}
+}
+
+/**
+ * Loads the gate TrainCascade made for the model, if it is in Models
+ * (Model.gate.txt), so the model only runs on windows that could be a
+ * gesture
+ */
+void LoadGestureGate()
+{
+	const char* path = "../../Models/Model.gate.txt";
+	FILE* file = fopen(path, "r");
+	if (file == NULL) {
+		return;
+	}
+	fclose(file);
+	g_GestureGate = svm_load_model(path);
+	if (g_GestureGate != NULL) {
+		printf("Cascade with the gate %s\n", path);
+		g_UserTracking.setGestureGate(g_GestureGate);
+	}
+}
+
+/**
+ * Loads the idle gate MotionThreshold learned for the model, if it is in
+ * Models (Model.idle.txt), so users whose arms are still are NOTHING
+ * without running the model
+ */
+void LoadIdleGate()
+{
+	const char* path = "../../Models/Model.idle.txt";
+	double threshold;
+	int label;
+	if (!GestureRecognizer::LoadIdleGate(path, &threshold, &label)) {
+		return;
+	}
+	if (label != NOTHING) {
+		printf("Ignoring %s, its idle class %d isn't NOTHING\n", path, label);
+		return;
+	}
+	printf("Idle gate %.2f from %s\n", threshold, path);
+	g_UserTracking.setIdleGate(threshold);
+}
+
+/**
+ * Runs on the main thread whenever a user's gesture starts, is still held
+ * or ends. Selects the first user to put their hands up and reports the
+ * selected user's gestures.
+ *
+ * Selection needs exactly one user with their hands up, so it is tried
+ * again on every HANDS_UP event while nobody is selected: a hold keeps
+ * retrying, and a release may leave a single user still holding.
+ */
+void GestureChanged(void* pCookie, const GestureEvent& event)
+{
+	if (g_UserTracking.getSelectedUser() == NULL && event.label == HANDS_UP) {
+		g_UserTracking.findUsersByGesture(HANDS_UP);
+	}
+	User* selected = g_UserTracking.getSelectedUser();
+	if (selected == NULL || selected->getId() != event.userId) {
+		return;
+	}
+	switch (event.type) {
+	case GESTURE_ONSET:
+		printf("User %d Performing: %s\n", event.userId, GestureToString((Gesture)event.label));
+		break;
+	case GESTURE_HOLD:
+		printf("User %d Still performing: %s (%.1f s)\n", event.userId, GestureToString((Gesture)event.label), event.frames / 30.0);
+		break;
+	case GESTURE_RELEASE:
+		printf("User %d Stopped: %s\n", event.userId, GestureToString((Gesture)event.label));
+		break;
+	}
+}
+
+/**
+ * Runs on the main thread for each frame coming out of the pipeline
+ */
+void RecognizeFrame(void* pCookie, const SkeletonFrame& frame)
+{
+	g_UserTracking.updateAllData(frame);
+}
+
+int main(int argc, char* argv[]) {
+	const char* earlyStages = "30,45";
+	double earlyThreshold = 0.9;
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 < argc && strcmp(argv[i], "-e") == 0) {
+			earlyThreshold = atof(argv[++i]);
+		} else if (i + 1 < argc && strcmp(argv[i], "-E") == 0) {
+			earlyStages = argv[++i];
+		} else {
+			printf("Unknown option %s\nUsage: ./Example [-e threshold] [-E frames,...|none]\n", argv[i]);
+			return -1;
+		}
+	}
+
 	XnStatus nRetVal = XN_STATUS_OK;
 	xn::Context context;
 	nRetVal = context.Init();
@@ -105,8 +248,23 @@ int main() {
 	CHECK_RC(nRetVal, "Generate");
 	printf("Welcome to Example 1...Press any key to exit gracefully!\n");
 	printf("This example tracks a single person (person who first puts their hands in the air)\n");
+	LoadEarlyModels(earlyStages, earlyThreshold);
+	LoadGestureGate();
+	LoadIdleGate();
+	// predicting every 3rd frame costs a third of the CPU for about the same
+	// accuracy, smoothed over the last 3 predictions
+	g_UserTracking.setGestureSmoothing(3, SMOOTHING_SCORE, 3, 0.0);
+	// once someone is selected the others are only watched for HANDS_UP, two
+	// of them a frame however many people walk by
+	g_UserTracking.setPredictionBudget(2);
+	// classify less while frames take longer than the sensor's 33 ms
+	g_UserTracking.setFrameBudget(33.3);
+	// only print when a gesture starts or ends, not every frame
+	g_UserTracking.addGestureListener(GestureChanged, NULL);
 
-        bool bDoOnce = true;
+	// From here on only the capture thread talks to OpenNI
+	OpenNISkeletonSource source(&context, &g_UserGenerator);
+	g_Pipeline.Start(SkeletonSource::Capture, &source);
 
 	//////////////////////////////////////////////////////////////////////////////////////////
 	// Main loop where all execution will happen
@@ -114,25 +272,23 @@ int main() {
 	while (!xnOSWasKeyboardHit()) {
 
                     //////////////////////////////////////////////////////////////////////////////////////
-                    // Update Kinect/Phone data and users
+                    // Update users from the next captured frame
                     // DO NOT DELETE
                     /////////////////////////////////////////////////////////////////////////////////////
-                    nRetVal = context.WaitAndUpdateAll();
-                    CHECK_RC(nRetVal, "WaitAndUpdatAll");
-                    g_UserTracking.updateAllData(&g_UserGenerator);
+                    if(!g_Pipeline.ProcessFrame(RecognizeFrame, NULL, 100))
+                    {
+                        if(!g_Pipeline.IsRunning())
+                        {
+                            break;
+                        }
+                        continue;
+                    }
 
 
                     //////////////////////////////////////////////////////////////////////////////////////
                     // Other logic
+                    // Gestures are handled by GestureChanged as they start and end
                     /////////////////////////////////////////////////////////////////////////////////////
-                    if(g_UserTracking.getSelectedUser()==NULL)
-                        {
-                            g_UserTracking.findUsersByGesture(HANDS_UP);
-                        }
-                    else
-			{
-				printf("User %d Performing: %s\n",g_UserTracking.getSelectedUser()->getId(),GestureToString(g_UserTracking.getSelectedUser()->getCurrentGesture()));
-			}
 
 	}
 
@@ -141,7 +297,11 @@ int main() {
 	// Clean up resources
 	// DO NOT DELETE
 	////////////////////////////////////////////////////////////////////////////////////////
+	g_Pipeline.Stop();
+	g_Pipeline.PrintStats(stdout);
+	g_UserTracking.printQualityStats(stdout);
+	nRetVal = g_Pipeline.GetCaptureStatus();
 	context.Release();
 
-	return 0;
+	return nRetVal;
 }
@@ -0,0 +1,183 @@
+#include "PositionHistory.h"
+#include "GlobalDefs.h"
+#include <cmath>
+
+/**
+ * Constructor
+ */
+PositionHistory::PositionHistory()
+{
+	clear();
+}
+
+/**
+ * Remove all samples
+ */
+void PositionHistory::clear()
+{
+	newest=CAPACITY-1;
+	count=0;
+	displacement.X=displacement.Y=displacement.Z=0;
+	elapsed=0;
+	direction=0;
+	directionValid=true;
+}
+
+/**
+ * Number of samples stored
+ */
+int PositionHistory::size() const
+{
+	return count;
+}
+
+/**
+ * Has the window been filled
+ */
+bool PositionHistory::isFull() const
+{
+	return count==CAPACITY;
+}
+
+/**
+ * Slot of the sample framesBack frames before the newest one
+ */
+int PositionHistory::slotFromBack(int framesBack) const
+{
+	int slot = newest-framesBack;
+	if(slot<0)
+	{
+		slot+=CAPACITY;
+	}
+	return slot;
+}
+
+/**
+ * Add a new sample, overwriting the oldest one once the window is full
+ * @param position the position
+ * @param time timestamp of the position (microseconds)
+ */
+void PositionHistory::push(const XnVector3D& position, XnUInt64 time)
+{
+	newest = newest+1==CAPACITY ? 0 : newest+1;
+	positions[newest]=position;
+	times[newest]=time;
+	if(count<CAPACITY)
+	{
+		count++;
+	}
+	// oldest and newest samples are both at hand, so this is O(1)
+	const XnVector3D& oldest = fromBack(count-1);
+	displacement.X=position.X-oldest.X;
+	displacement.Y=position.Y-oldest.Y;
+	displacement.Z=position.Z-oldest.Z;
+	elapsed=time-timeFromBack(count-1);
+	directionValid=false;
+}
+
+/**
+ * Position framesBack frames before the most recent one (0 is the newest)
+ */
+const XnVector3D& PositionHistory::fromBack(int framesBack) const
+{
+	return positions[slotFromBack(framesBack)];
+}
+
+/**
+ * Timestamp framesBack frames before the most recent one (0 is the newest)
+ */
+XnUInt64 PositionHistory::timeFromBack(int framesBack) const
+{
+	return times[slotFromBack(framesBack)];
+}
+
+/**
+ * Find the newest sample taken at or before a time
+ *
+ * Frames arrive at a near constant rate, so the average frame period gives
+ * the answer directly and at most a couple of neighbours need checking.
+ * @return how many frames back the sample is, -1 if the time is before
+ * the window
+ */
+int PositionHistory::framesBackAtTime(XnUInt64 time) const
+{
+	if(count==0 || time<timeFromBack(count-1))
+	{
+		return -1;
+	}
+	XnUInt64 newestTime = timeFromBack(0);
+	if(time>=newestTime || count==1)
+	{
+		return 0;
+	}
+	XnUInt64 period = (newestTime-timeFromBack(count-1))/(count-1);
+	int framesBack = period>0 ? (int)((newestTime-time)/period) : 0;
+	if(framesBack>count-1)
+	{
+		framesBack=count-1;
+	}
+	// correct for jitter in the frame timing
+	while(framesBack>0 && timeFromBack(framesBack-1)<=time)
+	{
+		framesBack--;
+	}
+	while(framesBack<count-1 && timeFromBack(framesBack)>time)
+	{
+		framesBack++;
+	}
+	return framesBack;
+}
+
+/**
+ * Movement between the oldest and newest sample
+ */
+XnVector3D PositionHistory::getDisplacement() const
+{
+	return displacement;
+}
+
+/**
+ * Velocity between the oldest and newest sample (units per second), zero
+ * until two samples with different timestamps have been added
+ */
+XnVector3D PositionHistory::getVelocity() const
+{
+	XnVector3D velocity;
+	velocity.X=velocity.Y=velocity.Z=0;
+	if(elapsed>0)
+	{
+		XnFloat seconds = elapsed/1000000.0f;
+		velocity.X=displacement.X/seconds;
+		velocity.Y=displacement.Y/seconds;
+		velocity.Z=displacement.Z/seconds;
+	}
+	return velocity;
+}
+
+/**
+ * Direction of travel (radians) between the oldest and newest sample in
+ * the X/Z plane. Only recomputed once per new sample.
+ */
+XnFloat PositionHistory::getDirection() const
+{
+	if(!directionValid)
+	{
+		direction = directionOf(displacement.X, displacement.Z);
+		directionValid=true;
+	}
+	return direction;
+}
+
+/**
+ * Angle (radians) of a movement in the X/Z plane, 0 is to the right,
+ * PI/2 is away from the Kinect. Always in [0,2PI).
+ */
+XnFloat PositionHistory::directionOf(XnFloat deltaX, XnFloat deltaZ)
+{
+	XnFloat angle = atan2(deltaZ, deltaX);
+	if(angle<0)
+	{
+		angle+=2*PI;
+	}
+	return angle;
+}
@@ -0,0 +1,60 @@
+/////////////////////////////////////////////////////////////////
+// PositionHistory.h
+//
+// A fixed size ring buffer of timestamped positions. Used to keep
+// the last couple of seconds of a user's torso position without
+// allocating, and to answer questions about it (position n frames
+// back, position at a time, velocity, direction) in constant time.
+//
+// Author: Aaron Pulver
+///////////////////////////////////////////////////////////////
+
+#ifndef POSITION_HISTORY_H
+#define POSITION_HISTORY_H
+
+#include <XnOpenNI.h>
+
+class PositionHistory
+{
+public:
+	static const int CAPACITY = 60;
+
+private:
+	XnVector3D positions[CAPACITY];
+	XnUInt64 times[CAPACITY];
+	int newest; // slot of the most recent sample
+	int count;
+	/**
+	 * Movement and time between the oldest and newest sample, updated on push
+	 */
+	XnVector3D displacement;
+	XnUInt64 elapsed;
+	/**
+	 * Direction of travel over the whole window, computed on first use
+	 * after a push
+	 */
+	mutable XnFloat direction;
+	mutable bool directionValid;
+
+	int slotFromBack(int framesBack) const;
+
+public:
+	PositionHistory();
+
+	void push(const XnVector3D& position, XnUInt64 time);
+	void clear();
+	int size() const;
+	bool isFull() const;
+
+	const XnVector3D& fromBack(int framesBack) const;
+	XnUInt64 timeFromBack(int framesBack) const;
+	int framesBackAtTime(XnUInt64 time) const;
+
+	XnVector3D getDisplacement() const;
+	XnVector3D getVelocity() const;
+	XnFloat getDirection() const;
+
+	static XnFloat directionOf(XnFloat deltaX, XnFloat deltaZ);
+};
+
+#endif
@@ -0,0 +1,145 @@
+/////////////////////////////////////////////////////////////////////////
+// ReplayBenchmark.cpp
+//
+// Plays a recorded skeleton stream through UserTracking (feature updates
+// and classification for every user) without a Kinect, and reports how
+// many frames per second the recognition path sustains. Record a stream
+// with the optional last argument of KinectRecording.
+//
+// Usage: ./ReplayBenchmark <skeletonStream.txt> [workerThreads] [realtime] [-b budget] [-s userId] [-q ms] [-i idle.txt] [gate.txt]
+//   -b shares that many predictions a frame between the users other than
+//   the one -s selects (see UserTracking::setPredictionBudget)
+//   -q keeps each frame under that many ms (see UserTracking::setFrameBudget)
+//   -i reads the idle gate from that file instead of the example's
+//   (Models/Model.idle.txt, see MotionThreshold)
+//
+// Author: Aaron Pulver
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "UserTracking.h"
+#include "../../Src/GesturePipeline.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int main(int argc, char* argv[]) {
+	if(argc<2)
+	{
+		printf("Missing arguments\nUsage: ./ReplayBenchmark <skeletonStream.txt> [workerThreads] [realtime] [-b budget] [-s userId] [-q ms] [-i idle.txt] [gate.txt]\n");
+		return -1;
+	}
+	int numThreads = 0;
+	if(argc>2)
+	{
+		numThreads = atoi(argv[2]);
+	}
+	bool realTime = false;
+	struct svm_model* gate = NULL;
+	int budget = 0;
+	int selectId = 0;
+	double frameBudget = 0.0;
+	const char* idlePath = "../../Models/Model.idle.txt";
+	for(int i=3;i<argc;i++)
+	{
+		if(strcmp(argv[i],"realtime")==0)
+		{
+			realTime = true;
+		}
+		else if(i+1<argc && strcmp(argv[i],"-b")==0)
+		{
+			budget = atoi(argv[++i]);
+		}
+		else if(i+1<argc && strcmp(argv[i],"-s")==0)
+		{
+			selectId = atoi(argv[++i]);
+		}
+		else if(i+1<argc && strcmp(argv[i],"-q")==0)
+		{
+			frameBudget = atof(argv[++i]);
+		}
+		else if(i+1<argc && strcmp(argv[i],"-i")==0)
+		{
+			idlePath = argv[++i];
+		}
+		else if(gate==NULL && (gate = svm_load_model(argv[i]))==NULL)
+		{
+			printf("Can't load the gate model %s\n",argv[i]);
+			return -1;
+		}
+	}
+
+	ReplaySkeletonSource source(realTime);
+	if(!source.Open(argv[1]))
+	{
+		return -1;
+	}
+	UserTracking tracking(numThreads);
+	tracking.setGestureQueueCapacity(1024);
+	// the example's idle gate, so the count of predictions that skip the model
+	// is what it would see
+	double idleThreshold = 0.0;
+	int idleLabel = NOTHING;
+	if(GestureRecognizer::LoadIdleGate(idlePath,&idleThreshold,&idleLabel) && idleLabel!=NOTHING)
+	{
+		printf("Ignoring %s, its idle class %d isn't NOTHING\n",idlePath,idleLabel);
+		idleThreshold = 0.0;
+	}
+	tracking.setIdleGate(idleThreshold);
+	tracking.setGestureGate(gate);
+	tracking.setPredictionBudget(budget);
+	tracking.setFrameBudget(frameBudget);
+	long gestureEvents[GESTURE_RELEASE+1] = {0};
+
+	long frames = 0;
+	long userFrames = 0;
+	clock_t cpuStart = clock();
+	XnUInt64 wallStart = GesturePipeline::Now();
+	SkeletonFrame frame;
+	XnStatus nRetVal;
+	while((nRetVal = source.NextFrame(frame)) == XN_STATUS_OK)
+	{
+		tracking.updateAllData(frame);
+		if(selectId!=0 && tracking.getSelectedUser()==NULL)
+		{
+			tracking.selectUser(selectId);
+		}
+		GestureEvent event;
+		while(tracking.pollGestureEvent(event))
+		{
+			gestureEvents[event.type]++;
+		}
+		frames++;
+		userFrames += frame.nUsers;
+	}
+	double wallSeconds = (GesturePipeline::Now()-wallStart)/1e9;
+	double cpuSeconds = (clock()-cpuStart)/(double)CLOCKS_PER_SEC;
+	if(nRetVal != SKELETON_STATUS_EOF)
+	{
+		printf("Replay failed: %s\n", xnGetStatusString(nRetVal));
+		return nRetVal;
+	}
+
+	printf("Frames: %ld (%ld user frames), worker threads: %d%s\n",frames,userFrames,numThreads,realTime?", real time":"");
+	printf("Wall time: %.3f s  CPU time: %.3f s\n",wallSeconds,cpuSeconds);
+	FrameResamplerStats resampled = tracking.getResamplerStats();
+	printf("Resampled to %llu frames at 30 Hz (%llu duplicates, %llu gaps)\n",(unsigned long long)resampled.framesOut,
+			(unsigned long long)resampled.duplicates,(unsigned long long)resampled.gaps);
+	GesturePredictionStats predictions = tracking.getPredictionStats();
+	printf("Predictions: %llu, %llu of them idle and %llu rejected by the gate without the model\n",
+			(unsigned long long)predictions.predictions,(unsigned long long)predictions.idle,
+			(unsigned long long)predictions.rejected);
+	printf("Model time: %.1f us per prediction\n",predictions.predictions>0 ? predictions.modelNs/1e3/predictions.predictions : 0.0);
+	if(frameBudget>0)
+	{
+		tracking.printQualityStats(stdout);
+	}
+	printf("Gesture events: %ld onsets, %ld holds, %ld releases\n",gestureEvents[GESTURE_ONSET],gestureEvents[GESTURE_HOLD],
+			gestureEvents[GESTURE_RELEASE]);
+	if(wallSeconds>0 && cpuSeconds>0)
+	{
+		printf("Frames/s: %.1f  User frames/s: %.1f\n",frames/wallSeconds,userFrames/wallSeconds);
+		printf("Frames/s per core: %.1f  User frames/s per core: %.1f\n",frames/cpuSeconds,userFrames/cpuSeconds);
+	}
+	return 0;
+}
@@ -1,5 +1,7 @@
 #include "GlobalDefs.h"
 #include "User.h"
+#include <utility>
+#include <algorithm>
 
 /**
  * Constructor
@@ -9,6 +11,8 @@ User::User(int ID)
 {
   gestureRecognizer.LoadModel((char*)"../../Models/Model.txt");
   id=ID;
+  setEarlyDetector(NULL);
+  setGestureDebounce(GESTURE_DEFAULT_ONSET_FRAMES,GESTURE_DEFAULT_RELEASE_FRAMES,GESTURE_DEFAULT_HOLD_FRAMES);
 }
 /**
  * Constructor
@@ -18,6 +22,8 @@ User::User()
 {
 	gestureRecognizer.LoadModel((char*)"../../Models/Model.txt");
 	id=0;
+	setEarlyDetector(NULL);
+	setGestureDebounce(GESTURE_DEFAULT_ONSET_FRAMES,GESTURE_DEFAULT_RELEASE_FRAMES,GESTURE_DEFAULT_HOLD_FRAMES);
 }
 
 /**
@@ -57,23 +63,61 @@ void User::setId(int id)
  * Copy Constructor
  */
 User::User(const User& other)
+	: gestureRecognizer(other.gestureRecognizer), jointGate(other.jointGate), earlyDetector(other.earlyDetector),
+	  earlyGesture(other.earlyGesture), gestureDebouncer(other.gestureDebouncer), numGestureEvents(other.numGestureEvents),
+	  id(other.id), torsoPositions(other.torsoPositions)
 {
-	this->id=other.id;
-	this->gestureRecognizer = other.gestureRecognizer;
-	this->torsoPositions = other.torsoPositions;
+	std::copy(other.gestureEvents,other.gestureEvents+numGestureEvents,gestureEvents);
+}
+
+/**
+ * Move Constructor
+ * Steals the feature window and position history instead of copying them
+ */
+User::User(User&& other)
+	: gestureRecognizer(std::move(other.gestureRecognizer)), jointGate(other.jointGate), earlyDetector(other.earlyDetector),
+	  earlyGesture(other.earlyGesture), gestureDebouncer(other.gestureDebouncer), numGestureEvents(other.numGestureEvents),
+	  id(other.id), torsoPositions(std::move(other.torsoPositions))
+{
+	std::copy(other.gestureEvents,other.gestureEvents+numGestureEvents,gestureEvents);
+	other.id=0;
 }
 
 /**
  * Assignment operator
  */
-User User::operator=(const User &other )
+User& User::operator=(const User &other )
 {
 	this->id=other.id;
 	this->gestureRecognizer = other.gestureRecognizer;
+	this->jointGate = other.jointGate;
+	this->earlyDetector = other.earlyDetector;
+	this->earlyGesture = other.earlyGesture;
+	this->gestureDebouncer = other.gestureDebouncer;
+	this->numGestureEvents = other.numGestureEvents;
+	std::copy(other.gestureEvents,other.gestureEvents+numGestureEvents,gestureEvents);
 	this->torsoPositions = other.torsoPositions;
 	return *this;
 }
 
+/**
+ * Move assignment operator
+ */
+User& User::operator=(User &&other )
+{
+	this->id=other.id;
+	this->gestureRecognizer = std::move(other.gestureRecognizer);
+	this->jointGate = other.jointGate;
+	this->earlyDetector = other.earlyDetector;
+	this->earlyGesture = other.earlyGesture;
+	this->gestureDebouncer = other.gestureDebouncer;
+	this->numGestureEvents = other.numGestureEvents;
+	std::copy(other.gestureEvents,other.gestureEvents+numGestureEvents,gestureEvents);
+	this->torsoPositions = std::move(other.torsoPositions);
+	other.id=0;
+	return *this;
+}
+
 XnFloat User::getCurrentDistance()
 {
   XnVector3D position = getCurrentPosition();
@@ -83,16 +127,36 @@ XnFloat User::getCurrentDistance()
 
 
 /**
- * Add a new position/time to the rolling queue window
+ * Add a new frame of joints to the rolling queue window. Low confidence
+ * joints are held at their last good position, and the frame is only
+ * classified if the joint gate lets it through.
+ * @param predict false to only update the window and keep the gesture, when
+ * the user is not scheduled to be classified this frame
  */
-void User::addPosition(XnVector3D torso, XnVector3D leftShoulder, XnVector3D rightShoulder, XnVector3D leftElbow, XnVector3D rightElbow, XnVector3D leftHand, XnVector3D rightHand, XnUInt64 newTime)
+void User::addSkeleton(const UserSkeleton& skeleton, XnUInt64 newTime, bool predict)
 {
-  if(torsoPositions.size()==QUEUE_SIZE)
+  UserSkeleton joints = skeleton;
+  bool classify = jointGate.Apply(joints);
+  gestureRecognizer.UpdateFeatures(joints,classify,predict);
+  if(earlyDetector!=NULL && predict)
+  {
+    earlyGesture = earlyDetector->Detect(gestureRecognizer);
+  }
+  torsoPositions.push(joints.GetJoint(SKELETON_TORSO),newTime);
+  numGestureEvents = gestureDebouncer.Update(getEarlyGesture(),gestureEvents);
+  for(int i=0;i<numGestureEvents;i++)
   {
-    torsoPositions.pop_front();
+    gestureEvents[i].userId = id;
+    gestureEvents[i].timestamp = newTime;
   }
-  gestureRecognizer.UpdateFeatures(torso,leftShoulder,leftElbow, leftHand, rightShoulder, rightElbow, rightHand);
-  torsoPositions.push_back(torso);
+}
+
+/**
+ * How many of this user's frames were gated and joints held
+ */
+JointGateStats User::getJointGateStats() const
+{
+  return jointGate.GetStats();
 }
 
 /**
@@ -102,7 +166,7 @@ XnVector3D User::getCurrentPosition()
 {
   if(torsoPositions.size()>=1)
   {
-    return torsoPositions.back();
+    return torsoPositions.fromBack(0);
   }
   else
   {
@@ -117,7 +181,8 @@ XnFloat User::getCurrentAngle()
 {
 	if(torsoPositions.size()>=1)
 	{
-		return (atan(torsoPositions.back().X/torsoPositions.back().Z));
+		const XnVector3D& position = torsoPositions.fromBack(0);
+		return (atan(position.X/position.Z));
 	}
 	else
 	{
@@ -132,44 +197,41 @@ XnFloat User::getCurrentAngle()
 XnFloat User::getCurrentDirection( int framesBack)
 {
 	int size = torsoPositions.size();
-	if(size<60)
+	if(size<QUEUE_SIZE || framesBack<1 || framesBack>size)
 	{
 		return 0.0;
 	}
+	else if(framesBack==size)
+	{
+		// whole window, kept up to date by the history
+		return torsoPositions.getDirection();
+	}
 	else
 	{
-		float deltaX=(torsoPositions.back().X-torsoPositions[size-framesBack].X);
-		float deltaZ=(torsoPositions.back().Z-torsoPositions[size-framesBack].Z);
-		float angle = atan(deltaZ/deltaX);
-		// lower left quadrant
-		if(deltaX <0 && deltaZ<0)
-		{
-		  angle+=PI;
-		}
-		// upper left quadrant
-		else if(deltaX <0 && deltaZ>0)
-		{
-		  angle+=PI;
-		}
-		// lower right quadrant
-		else if(deltaX >0 && deltaZ<0)
-		{
-		  angle +=2*PI;
-		}
-
-		return angle;
+		const XnVector3D& current = torsoPositions.fromBack(0);
+		const XnVector3D& previous = torsoPositions.fromBack(framesBack-1);
+		return PositionHistory::directionOf(current.X-previous.X, current.Z-previous.Z);
 	}
 }
 
+/**
+ * Get the velocity (mm/s) of the user over the last QUEUE_SIZE frames
+ */
+XnVector3D User::getCurrentVelocity()
+{
+	return torsoPositions.getVelocity();
+}
+
 /**
  * Is the user in the frame. Checks if last two positions are identical.
  */
 bool User::isInFrame()
 {
-	int size = torsoPositions.size();
-	if(size>=2)
+	if(torsoPositions.size()>=2)
 	{
-		return !((torsoPositions[size-1].X == torsoPositions[size-2].X) && (torsoPositions[size-1].Y == torsoPositions[size-2].Y) && (torsoPositions[size-1].Z == torsoPositions[size-2].Z));
+		const XnVector3D& current = torsoPositions.fromBack(0);
+		const XnVector3D& previous = torsoPositions.fromBack(1);
+		return !((current.X == previous.X) && (current.Y == previous.Y) && (current.Z == previous.Z));
 	}
 	else
 	{
@@ -181,7 +243,120 @@ bool User::isInFrame()
  */
 Gesture User::getCurrentGesture()
 {
-	return (Gesture)gestureRecognizer.Classify();
+	return (Gesture)gestureRecognizer.GetGesture();
+}
+
+/**
+ * Predict every few frames and smooth the predictions into the current
+ * gesture (see GestureRecognizerBase::SetStride and SetSmoothing)
+ */
+void User::setGestureSmoothing(int stride, GestureSmoothing mode, int window, double hysteresis)
+{
+	gestureRecognizer.SetStride(stride);
+	gestureRecognizer.SetSmoothing(mode,window,hysteresis);
+}
+
+/**
+ * Predict every stride frames, keeping the recent predictions
+ */
+void User::setGestureStride(int stride)
+{
+	gestureRecognizer.SetStride(stride);
+}
+
+/**
+ * How many frames a gesture must be seen before its onset event and be gone
+ * before its release, and how often it sends hold events (0 for none).
+ * Forgets the gesture in progress without a release event.
+ */
+void User::setGestureDebounce(int onsetFrames, int releaseFrames, int holdFrames)
+{
+	gestureDebouncer = GestureDebouncer(onsetFrames,releaseFrames,holdFrames,NOTHING);
+	numGestureEvents = 0;
+}
+
+/**
+ * Skip the model and report NOTHING while the user's arms are still (see
+ * GestureRecognizerBase::SetIdleGate)
+ * @param threshold learned with MotionThreshold, 0 to always run the model
+ */
+void User::setIdleGate(double threshold)
+{
+	gestureRecognizer.SetIdleGate(threshold,NOTHING);
+}
+
+/**
+ * Only run the model on windows a cheap first stage lets through (see
+ * GestureRecognizerBase::SetGate)
+ * @param gate trained with TrainCascade, shared by every user, NULL for none
+ */
+void User::setGestureGate(const struct svm_model* gate)
+{
+	gestureRecognizer.SetGate(gate);
+}
+
+/**
+ * How many predictions were made for this user and how many skipped the
+ * model
+ */
+GesturePredictionStats User::getPredictionStats() const
+{
+	return gestureRecognizer.GetPredictionStats();
+}
+
+/**
+ * The onset, hold and release events the newest frame caused
+ * @param count set to how many there are
+ */
+const GestureEvent* User::getGestureEvents(int& count) const
+{
+	count = numGestureEvents;
+	return gestureEvents;
+}
+
+/**
+ * End the gesture in progress, use when the user is lost
+ * @param events room for GESTURE_MAX_EVENTS, set to its release if there
+ * is a gesture in progress
+ * @return how many events there are
+ */
+int User::releaseGesture(GestureEvent* events)
+{
+	int count = gestureDebouncer.Reset(events);
+	for(int i=0;i<count;i++)
+	{
+		events[i].userId = id;
+		events[i].timestamp = torsoPositions.size()>0 ? torsoPositions.timeFromBack(0) : 0; // its last frame
+	}
+	numGestureEvents = 0;
+	return count;
+}
+
+/**
+ * Use partial window models to report gestures before the full window
+ * holds them
+ * @param detector shared by every user, NULL to only use the full window
+ */
+void User::setEarlyDetector(const EarlyDetector* detector)
+{
+	earlyDetector=detector;
+	earlyGesture.label=0;
+	earlyGesture.predicted=0;
+	earlyGesture.frames=0;
+	earlyGesture.confidence=0.0;
+}
+
+/**
+ * Gets the gesture being performed as soon as the early detector is sure
+ * of it, the full window's gesture otherwise
+ */
+Gesture User::getEarlyGesture()
+{
+	if(earlyGesture.label!=0)
+	{
+		return (Gesture)earlyGesture.label;
+	}
+	return getCurrentGesture();
 }
 
 /**
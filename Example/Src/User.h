@@ -12,48 +12,83 @@
 #ifndef USER_h
 #define USER_h
 
-#include <deque>
 #include <XnOpenNI.h>
 #include <cmath>
 #include "GlobalDefs.h"
+#include "PositionHistory.h"
 #include "../../Src/GestureRecognizer.h"
+#include "../../Src/JointGate.h"
+#include "../../Src/EarlyDetector.h"
+#include "../../Src/GestureDebouncer.h"
 
 class User
 {
 private:
-	static const int QUEUE_SIZE = 60;
+	static const int QUEUE_SIZE = PositionHistory::CAPACITY;
 	static const int MIN_VARIANCE = 75;
 	static const int THRESHOLD_SIZE = 30;
 	GestureRecognizer gestureRecognizer;
+	/**
+	 * Holds this user's lost joints and skips classifying frames with
+	 * too many of them
+	 */
+	JointGate jointGate;
+	/**
+	 * Partial window models shared by every user (may be NULL) and what
+	 * they reported for this user's newest frame
+	 */
+	const EarlyDetector* earlyDetector;
+	EarlyDetection earlyGesture;
+	/**
+	 * Turns this user's gesture into onset, hold and release events, and
+	 * the events the newest frame caused
+	 */
+	GestureDebouncer gestureDebouncer;
+	GestureEvent gestureEvents[GESTURE_MAX_EVENTS];
+	int numGestureEvents;
 
 	/*
 	 * The unique id of the user [1-15]
 	 */
     int id;
     /**
-     * A queue of positions
+     * The last QUEUE_SIZE torso positions and when they were seen
      */
-    std::deque<XnVector3D> torsoPositions;
+    PositionHistory torsoPositions;
 
 public:
   User(int id);
   User(const User& other);
+  User(User&& other);
   User();
   ~User();
 
   int getId() const;
   void setId(int id);
-  void addPosition(XnVector3D torso, XnVector3D leftShoulder, XnVector3D rightShoulder, XnVector3D leftElbow, XnVector3D rightElbow, XnVector3D leftHand, XnVector3D rightHand , XnUInt64 newTime);
+  void addSkeleton(const UserSkeleton& skeleton, XnUInt64 newTime, bool predict = true);
+  JointGateStats getJointGateStats() const;
   XnVector3D getCurrentPosition();
   XnFloat getCurrentAngle();
   XnFloat getCurrentDirection(int framesBack);
+  XnVector3D getCurrentVelocity();
   bool isInFrame();
   Gesture getCurrentGesture();
+  void setEarlyDetector(const EarlyDetector* detector);
+  void setGestureSmoothing(int stride, GestureSmoothing mode, int window, double hysteresis);
+  void setGestureStride(int stride);
+  void setGestureDebounce(int onsetFrames, int releaseFrames, int holdFrames);
+  void setIdleGate(double threshold);
+  void setGestureGate(const struct svm_model* gate);
+  GesturePredictionStats getPredictionStats() const;
+  const GestureEvent* getGestureEvents(int& count) const;
+  int releaseGesture(GestureEvent* events);
+  Gesture getEarlyGesture();
   XnFloat getCurrentDistance();
 
   bool operator== (const User &other) const;
   bool operator!= (const User &other) const;
-  User operator=(const User & rhs);
+  User& operator=(const User & rhs);
+  User& operator=(User && rhs);
   
 };
   
@@ -6,13 +6,60 @@
  */
 
 #include "UserTracking.h"
+#include "../../Src/GesturePipeline.h"
 
 /**
  * Constructor
  */
 UserTracking::UserTracking()
+	: m_workers(WorkerPool::DefaultThreadCount(MAX_USER_ID-1))
+{
+	init();
+}
+
+/**
+ * Constructor
+ * @param numWorkerThreads threads used to update users in parallel, on top
+ * of the thread calling updateAllData
+ */
+UserTracking::UserTracking(int numWorkerThreads)
+	: m_workers(numWorkerThreads)
+{
+	init();
+}
+
+/**
+ * Start with no users
+ */
+void UserTracking::init()
 {
 	m_selectedUserId=0;
+	m_predictionBudget=0;
+	m_nextScheduledId=1;
+	m_earlyDetector=NULL;
+	m_stride=1;
+	m_smoothing=SMOOTHING_NONE;
+	m_smoothingWindow=1;
+	m_hysteresis=0.0;
+	m_onsetFrames=GESTURE_DEFAULT_ONSET_FRAMES;
+	m_releaseFrames=GESTURE_DEFAULT_RELEASE_FRAMES;
+	m_holdFrames=GESTURE_DEFAULT_HOLD_FRAMES;
+	m_gestureQueueCapacity=0;
+	m_idleThreshold=0.0;
+	m_gestureGate=NULL;
+	m_qualityControl=false;
+	m_quality.SetNumLevels(QUALITY_LEVELS);
+	m_removedStats.predictions=0;
+	m_removedStats.idle=0;
+	m_removedStats.rejected=0;
+	m_removedStats.modelNs=0;
+	m_numActiveUsers=0;
+	m_pendingTime=0;
+	for(int i=0;i<=MAX_USER_ID;i++)
+	{
+		m_users[i]=NULL;
+		m_activeIndex[i]=-1;
+	}
 }
 
 /**
@@ -20,6 +67,23 @@ UserTracking::UserTracking()
  */
 UserTracking::~UserTracking()
 {
+	for(int i=0;i<=MAX_USER_ID;i++)
+	{
+		delete m_users[i];
+		m_users[i]=NULL;
+	}
+}
+
+/**
+ * Get the user in the slot for an id, NULL if it is not being tracked
+ */
+User* UserTracking::getUser(int id)
+{
+	if(id<1 || id>MAX_USER_ID)
+	{
+		return NULL;
+	}
+	return m_users[id];
 }
 
 
@@ -30,13 +94,7 @@ User* UserTracking::getSelectedUser()
 {
 	if(m_selectedUserId!=0)
 	{
-		for(int i=0;i<m_users.size();i++)
-		{
-			if(m_selectedUserId==m_users[i].getId())
-			{
-				return &m_users[i];
-			}
-		}
+		return getUser(m_selectedUserId);
 	}
 	else
 	{
@@ -62,26 +120,38 @@ bool UserTracking::isTracking()
 }
 
 
+bool UserTracking::clearSelectedUser()
+{
+	m_selectedUserId=0;
+	m_userIdsFollowing.clear();
+}
+
 /**
- * Update user position
+ * Track a user without waiting for their gesture
+ * @return false if the user is not being tracked
  */
-bool UserTracking::updateUserPosition(int id, XnVector3D torso, XnVector3D leftShoulder, XnVector3D rightShoulder, XnVector3D leftElbow,XnVector3D rightElbow, XnVector3D leftHand, XnVector3D rightHand, XnUInt64 newTime)
+bool UserTracking::selectUser(int id)
 {
-	for(int i=0;i<m_users.size();i++)
+	if(getUser(id)==NULL)
 	{
-		if(m_users[i].getId()==id)
-		{
-			m_users[i].addPosition(torso,leftShoulder,rightShoulder, leftElbow,rightElbow,leftHand, rightHand, newTime );
-			return true;
-		}
+		return false;
 	}
-	return false;
+	m_selectedUserId=id;
+	m_userIdsFollowing.assign(1,id);
+	return true;
 }
 
-bool UserTracking::clearSelectedUser()
+/**
+ * Bound what classifying a crowd costs. The selected user is classified
+ * every frame. The others are only watched for a gesture that selects
+ * them, so they share a fixed number of predictions a frame, round robin,
+ * and keep their last gesture in between.
+ * @param predictions a frame for everyone but the selected user, 0 to
+ * classify every user every frame
+ */
+void UserTracking::setPredictionBudget(int predictions)
 {
-	m_selectedUserId=0;
-	m_userIdsFollowing.clear();
+	m_predictionBudget=predictions<0 ? 0 : predictions;
 }
 
 /**
@@ -91,11 +161,11 @@ int UserTracking::findUsersByGesture(Gesture gesture)
 {
 	int found=0;
 	m_userIdsFollowing.clear(); // remove users
-	for(int i=0;i<m_users.size();i++)
+	for(int i=0;i<m_numActiveUsers;i++)
 	{
-		if((Gesture)m_users[i].getCurrentGesture()==gesture)
+		if((Gesture)m_activeUsers[i]->getEarlyGesture()==gesture)
 		{
-			m_userIdsFollowing.push_back(m_users[i].getId());
+			m_userIdsFollowing.push_back(m_activeUsers[i]->getId());
 			found++;
 		}
 	}
@@ -115,14 +185,18 @@ int UserTracking::findUsersByGesture(Gesture gesture)
  */
 bool UserTracking::addKinectUser(int id)
 {
-	for(int i=0;i<m_users.size();i++)
+	if(id<1 || id>MAX_USER_ID || m_users[id]!=NULL)
 	{
-		if(m_users[i].getId()==id)
-		{
-			return false;
-		}
+		return false;
 	}
-	m_users.push_back(User(id));
+	m_users[id] = new User(id);
+	m_users[id]->setEarlyDetector(m_earlyDetector);
+	m_users[id]->setGestureSmoothing(effectiveStride(),m_smoothing,m_smoothingWindow,m_hysteresis);
+	m_users[id]->setGestureDebounce(m_onsetFrames,m_releaseFrames,m_holdFrames);
+	m_users[id]->setIdleGate(m_idleThreshold);
+	m_users[id]->setGestureGate(m_gestureGate);
+	m_activeIndex[id] = m_numActiveUsers;
+	m_activeUsers[m_numActiveUsers++] = m_users[id];
 	return true;
 }
 
@@ -131,55 +205,437 @@ bool UserTracking::addKinectUser(int id)
  */
 bool UserTracking::removeKinectUser(int id)
 {
-	for(int i=0;i<m_users.size();i++)
+	User* user = getUser(id);
+	if(user==NULL)
+	{
+		return false;
+	}
+	if(id==m_selectedUserId)
+	{
+		m_selectedUserId=0;
+	}
+	// move the last active user into the hole so the list stays dense
+	int index = m_activeIndex[id];
+	User* last = m_activeUsers[--m_numActiveUsers];
+	m_activeUsers[index] = last;
+	m_activeIndex[last->getId()] = index;
+	m_activeIndex[id] = -1;
+	// a lost user's gesture ends with them
+	GestureEvent events[GESTURE_MAX_EVENTS];
+	int count = user->releaseGesture(events);
+	GesturePredictionStats stats = user->getPredictionStats();
+	m_removedStats.predictions += stats.predictions;
+	m_removedStats.idle += stats.idle;
+	m_removedStats.rejected += stats.rejected;
+	m_removedStats.modelNs += stats.modelNs;
+	delete user;
+	m_users[id]=NULL;
+	dispatchGestureEvents(events,count);
+	return true;
+}
+
+/**
+ * Feeds one fetched skeleton to its user. Runs on the worker pool, so it
+ * must only touch that user's state.
+ */
+void UserTracking::updatePendingUser(void* pCookie, int index)
+{
+	UserTracking* tracking = (UserTracking*)pCookie;
+	const UserSkeleton& skeleton = *tracking->m_pendingSkeletons[index];
+	tracking->m_pendingUsers[index]->addSkeleton(skeleton,tracking->m_pendingTime,tracking->m_pendingPredict[index]);
+}
+
+/**
+ * Decide which pending users are classified this frame: the selected user
+ * and, within the budget, the others in turn by id. The quality level may
+ * shrink the budget (see QUALITY_LEVELS).
+ */
+void UserTracking::scheduleUsers(int nPending)
+{
+	int level = m_qualityControl ? m_quality.GetLevel() : 0;
+	int budget = m_predictionBudget;
+	if(level>=2 && (budget==0 || budget>1))
+	{
+		budget = 1;
+	}
+	bool others = level<3 || getSelectedUser()==NULL;
+	int pendingIndex[MAX_USER_ID+1];
+	for(int id=0;id<=MAX_USER_ID;id++)
+	{
+		pendingIndex[id]=-1;
+	}
+	for(int i=0;i<nPending;i++)
 	{
-		if(m_users[i].getId()==id)
+		bool selected = m_pendingUsers[i]->getId()==m_selectedUserId;
+		m_pendingPredict[i] = selected || (others && budget==0);
+		if(!selected)
 		{
-			if(m_users[i].getId()==m_selectedUserId)
-			{
-				m_selectedUserId=0;
-			}
-			m_users.erase(m_users.begin()+i);
-			return true;
+			pendingIndex[m_pendingUsers[i]->getId()]=i;
+		}
+	}
+	if(!others || budget==0)
+	{
+		return;
+	}
+	int id = m_nextScheduledId;
+	for(int n=0;n<MAX_USER_ID && budget>0;n++)
+	{
+		if(pendingIndex[id]>=0)
+		{
+			m_pendingPredict[pendingIndex[id]] = true;
+			budget--;
+			m_nextScheduledId = id%MAX_USER_ID+1;
+		}
+		id = id%MAX_USER_ID+1;
+	}
+}
+
+/**
+ * The stride users predict at, m_stride at full quality
+ */
+int UserTracking::effectiveStride() const
+{
+	int level = m_qualityControl ? m_quality.GetLevel() : 0;
+	return level>=3 ? m_stride*3 : (level>=1 ? m_stride*2 : m_stride);
+}
+
+/**
+ * Give every user the stride of the quality level
+ */
+void UserTracking::applyQuality()
+{
+	int stride = effectiveStride();
+	for(int i=0;i<m_numActiveUsers;i++)
+	{
+		m_activeUsers[i]->setGestureStride(stride);
+	}
+}
+
+/**
+ * Feeds every skeleton in the frame that belongs to a known user to that
+ * user. The feature update and classification for each user runs on the
+ * worker pool; this returns once every user has been updated.
+ */
+void UserTracking::updateUsers(const SkeletonFrame& frame)
+{
+	int nPending = 0;
+	m_pendingTime = frame.timestamp;
+	for(int i=0;i<frame.nUsers;i++)
+	{
+		User* user = getUser(frame.users[i].id);
+		if(user!=NULL)
+		{
+			m_pendingUsers[nPending] = user;
+			m_pendingSkeletons[nPending] = &frame.users[i];
+			nPending++;
 		}
 	}
-	return false;
+	scheduleUsers(nPending);
+	// update features and classify every user in parallel
+	m_workers.Run(nPending, updatePendingUser, this);
+	// then hand out what changed from this thread, collected first since a
+	// listener may remove users
+	GestureEvent events[MAX_USER_ID*GESTURE_MAX_EVENTS];
+	int numEvents = 0;
+	for(int i=0;i<nPending;i++)
+	{
+		int count;
+		const GestureEvent* userEvents = m_pendingUsers[i]->getGestureEvents(count);
+		for(int j=0;j<count;j++)
+		{
+			events[numEvents++] = userEvents[j];
+		}
+	}
+	dispatchGestureEvents(events,numEvents);
+}
+
+/**
+ * Resamples a captured frame onto the 30 Hz grid and updates users once for
+ * every grid point up to it (none for a repeated frame, several after a
+ * dropped one)
+ */
+void UserTracking::updateUsersResampled(const SkeletonFrame& frame)
+{
+	XnUInt64 start = m_qualityControl ? GesturePipeline::Now() : 0;
+	m_resampler.Push(frame);
+	while(m_resampler.Next(m_gridFrame))
+	{
+		updateUsers(m_gridFrame);
+	}
+	if(m_qualityControl && m_quality.Update(GesturePipeline::Now()-start))
+	{
+		applyQuality();
+	}
 }
 
 /**
  * Updates all of the fields by analyzing the userGenerator
+ *
+ * Only users added with addKinectUser are updated. Joints are fetched on
+ * the calling thread since OpenNI is not thread safe.
  */
 XnStatus UserTracking::updateAllData(xn::UserGenerator* userGenerator)
 {
-	XnSkeletonJointPosition torso;
-	XnSkeletonJointPosition leftShoulder;
-	XnSkeletonJointPosition rightShoulder;
-	XnSkeletonJointPosition leftElbow;
-	XnSkeletonJointPosition rightElbow;
-	XnSkeletonJointPosition leftHand;
-	XnSkeletonJointPosition rightHand;
-
-	XnUserID aUsers[15];
-	XnUInt16 nUsers = 15;
-
-	
-	XnStatus nRetVal = userGenerator->GetUsers(aUsers, nUsers);
-	CHECK_RC(nRetVal, "GetUsers");
-	// for each user get their joint locations and print them
-	for(int i= 0; i<nUsers; i++)
-	{
-		if (userGenerator->GetSkeletonCap().IsTracking(aUsers[i])) {
-			userGenerator->GetSkeletonCap().GetSkeletonJointPosition(aUsers[i], XN_SKEL_TORSO, torso);
-			userGenerator->GetSkeletonCap().GetSkeletonJointPosition(aUsers[i], XN_SKEL_LEFT_SHOULDER, leftShoulder);
-			userGenerator->GetSkeletonCap().GetSkeletonJointPosition(aUsers[i], XN_SKEL_LEFT_ELBOW, leftElbow);
-			userGenerator->GetSkeletonCap().GetSkeletonJointPosition(aUsers[i], XN_SKEL_LEFT_HAND, leftHand);
-			userGenerator->GetSkeletonCap().GetSkeletonJointPosition(aUsers[i], XN_SKEL_RIGHT_SHOULDER, rightShoulder);
-			userGenerator->GetSkeletonCap().GetSkeletonJointPosition(aUsers[i], XN_SKEL_RIGHT_ELBOW, rightElbow);
-			userGenerator->GetSkeletonCap().GetSkeletonJointPosition(aUsers[i], XN_SKEL_RIGHT_HAND, rightHand);
-			updateUserPosition(aUsers[i],torso.position,leftShoulder.position,rightShoulder.position,leftElbow.position,rightElbow.position,leftHand.position,rightHand.position,userGenerator->GetTimestamp());
+	XnStatus nRetVal = FetchSkeletonFrame(*userGenerator, m_frame);
+	CHECK_RC(nRetVal, "FetchSkeletonFrame");
+	updateUsersResampled(m_frame);
+	return XN_STATUS_OK;
+}
+
+/**
+ * Updates all of the fields from a frame captured on another thread
+ *
+ * The frame is treated as the full list of tracked users: users in the
+ * frame that are not known yet are added and known users missing from it
+ * are removed. That way the OpenNI callbacks (which run on the capture
+ * thread) never have to touch this object.
+ */
+XnStatus UserTracking::updateAllData(const SkeletonFrame& frame)
+{
+	bool inFrame[MAX_USER_ID+1] = {false};
+	for(int i=0;i<frame.nUsers;i++)
+	{
+		int id = frame.users[i].id;
+		if(id>=1 && id<=MAX_USER_ID)
+		{
+			inFrame[id]=true;
+			addKinectUser(id);
+		}
+	}
+	// walk backwards since removing swaps the last active user into place
+	for(int i=m_numActiveUsers-1;i>=0;i--)
+	{
+		int id = m_activeUsers[i]->getId();
+		if(!inFrame[id])
+		{
+			removeKinectUser(id);
 		}
 	}
-	//TODO
+	updateUsersResampled(frame);
 	return XN_STATUS_OK;
 }
 
+/**
+ * Reads the next frame from a source and updates all users from it
+ * (see updateAllData(const SkeletonFrame&))
+ * @return the source's status, SKELETON_STATUS_EOF when a replay has ended
+ */
+XnStatus UserTracking::updateAllData(SkeletonSource* source)
+{
+	XnStatus nRetVal = source->NextFrame(m_frame);
+	if(nRetVal != XN_STATUS_OK)
+	{
+		return nRetVal;
+	}
+	return updateAllData(m_frame);
+}
+
+/**
+ * How many frames came in and how many grid frames the users were updated
+ * with
+ */
+FrameResamplerStats UserTracking::getResamplerStats() const
+{
+	return m_resampler.GetStats();
+}
+
+/**
+ * Report gestures early from partial window models, for every user
+ * @param detector must outlive the tracking, NULL to only use full windows
+ */
+void UserTracking::setEarlyDetector(const EarlyDetector* detector)
+{
+	m_earlyDetector=detector;
+	for(int i=0;i<m_numActiveUsers;i++)
+	{
+		m_activeUsers[i]->setEarlyDetector(detector);
+	}
+}
+
+/**
+ * Predict every stride frames and smooth the predictions, for every user
+ * (see GestureRecognizerBase::SetStride and SetSmoothing)
+ */
+void UserTracking::setGestureSmoothing(int stride, GestureSmoothing mode, int window, double hysteresis)
+{
+	m_stride=stride;
+	m_smoothing=mode;
+	m_smoothingWindow=window;
+	m_hysteresis=hysteresis;
+	for(int i=0;i<m_numActiveUsers;i++)
+	{
+		m_activeUsers[i]->setGestureSmoothing(effectiveStride(),mode,window,hysteresis);
+	}
+}
+
+/**
+ * Skip the model while a user's arms are still, for every user (see
+ * User::setIdleGate)
+ */
+void UserTracking::setIdleGate(double threshold)
+{
+	m_idleThreshold=threshold;
+	for(int i=0;i<m_numActiveUsers;i++)
+	{
+		m_activeUsers[i]->setIdleGate(threshold);
+	}
+}
+
+/**
+ * Run a cheap first stage before the model, for every user (see
+ * User::setGestureGate)
+ * @param gate must outlive the tracking, NULL for none
+ */
+void UserTracking::setGestureGate(const struct svm_model* gate)
+{
+	m_gestureGate=gate;
+	for(int i=0;i<m_numActiveUsers;i++)
+	{
+		m_activeUsers[i]->setGestureGate(gate);
+	}
+}
+
+/**
+ * Keep processing a frame under a budget by classifying less when frames
+ * run over it, and restore full quality once there is headroom again (see
+ * QualityController and QUALITY_LEVELS)
+ * @param ms how long processing a captured frame may take, 0 to always
+ * classify at full quality
+ */
+void UserTracking::setFrameBudget(double ms)
+{
+	m_qualityControl = ms>0.0;
+	m_quality.SetBudget(ms);
+	m_quality.Reset();
+	applyQuality();
+}
+
+/**
+ * The quality level and the frame times that chose it
+ */
+QualityStats UserTracking::getQualityStats() const
+{
+	return m_quality.GetStats();
+}
+
+void UserTracking::printQualityStats(FILE* file) const
+{
+	m_quality.PrintStats(file);
+}
+
+/**
+ * How many predictions were made for every user so far, and how many of
+ * them skipped the model
+ */
+GesturePredictionStats UserTracking::getPredictionStats() const
+{
+	GesturePredictionStats stats = m_removedStats;
+	for(int i=0;i<m_numActiveUsers;i++)
+	{
+		GesturePredictionStats user = m_activeUsers[i]->getPredictionStats();
+		stats.predictions += user.predictions;
+		stats.idle += user.idle;
+		stats.rejected += user.rejected;
+		stats.modelNs += user.modelNs;
+	}
+	return stats;
+}
+
+/**
+ * How many frames a gesture must be seen before its onset event and be gone
+ * before its release, and how often it sends hold events (0 for none), for
+ * every user
+ */
+void UserTracking::setGestureDebounce(int onsetFrames, int releaseFrames, int holdFrames)
+{
+	m_onsetFrames=onsetFrames;
+	m_releaseFrames=releaseFrames;
+	m_holdFrames=holdFrames;
+	for(int i=0;i<m_numActiveUsers;i++)
+	{
+		m_activeUsers[i]->setGestureDebounce(onsetFrames,releaseFrames,holdFrames);
+	}
+}
+
+/**
+ * Call back on every gesture onset, hold and release
+ * @param userId only this user's events, 0 for every user's
+ */
+void UserTracking::addGestureListener(GestureCallback callback, void* pCookie, int userId)
+{
+	GestureListener listener;
+	listener.callback=callback;
+	listener.pCookie=pCookie;
+	listener.userId=userId;
+	m_gestureListeners.push_back(listener);
+}
+
+/**
+ * Stop calling back, for every user it was added for
+ */
+void UserTracking::removeGestureListener(GestureCallback callback, void* pCookie)
+{
+	for(size_t i=m_gestureListeners.size();i>0;i--)
+	{
+		if(m_gestureListeners[i-1].callback==callback && m_gestureListeners[i-1].pCookie==pCookie)
+		{
+			m_gestureListeners.erase(m_gestureListeners.begin()+(i-1));
+		}
+	}
+}
+
+/**
+ * Also queue every gesture event for pollGestureEvent
+ * @param capacity most events kept, the oldest are dropped beyond it. 0 to
+ * stop queueing.
+ */
+void UserTracking::setGestureQueueCapacity(size_t capacity)
+{
+	m_gestureQueueCapacity=capacity;
+	while(m_gestureQueue.size()>capacity)
+	{
+		m_gestureQueue.pop_front();
+	}
+}
+
+/**
+ * Take the oldest queued gesture event
+ * @return false if there is none
+ */
+bool UserTracking::pollGestureEvent(GestureEvent& event)
+{
+	if(m_gestureQueue.empty())
+	{
+		return false;
+	}
+	event=m_gestureQueue.front();
+	m_gestureQueue.pop_front();
+	return true;
+}
+
+/**
+ * Hand events to the listeners and the queue
+ */
+void UserTracking::dispatchGestureEvents(const GestureEvent* events, int count)
+{
+	for(int i=0;i<count;i++)
+	{
+		if(m_gestureQueueCapacity>0)
+		{
+			if(m_gestureQueue.size()==m_gestureQueueCapacity)
+			{
+				m_gestureQueue.pop_front();
+			}
+			m_gestureQueue.push_back(events[i]);
+		}
+		// by index, a listener may add or remove listeners
+		for(size_t j=0;j<m_gestureListeners.size();j++)
+		{
+			GestureListener listener=m_gestureListeners[j];
+			if(listener.userId==0 || listener.userId==events[i].userId)
+			{
+				listener.callback(listener.pCookie,events[i]);
+			}
+		}
+	}
+}
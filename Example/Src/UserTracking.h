@@ -13,19 +13,120 @@
 
 #include <XnOpenNI.h>
 #include <vector>
+#include <deque>
 #include <stdio.h>
 #include "User.h"
 #include "GlobalDefs.h"
+#include "../../Src/WorkerPool.h"
+#include "../../Src/SkeletonFrame.h"
+#include "../../Src/SkeletonSource.h"
+#include "../../Src/FrameResampler.h"
+#include "../../Src/QualityController.h"
+
+/**
+ * Called with every gesture event of the users it listens to, on the thread
+ * that updates the users
+ */
+typedef void (*GestureCallback)(void* pCookie, const GestureEvent& event);
 
 class UserTracking
 {
 private:
-	std::vector<User> m_users;
+	struct GestureListener
+	{
+		GestureCallback callback;
+		void* pCookie;
+		int userId; // 0 for every user
+	};
+	/**
+	 * Highest user id OpenNI hands out (ids are [1-15])
+	 */
+	static const int MAX_USER_ID = 15;
+	/**
+	 * Quality levels m_quality steps through: 0 is full quality, 1 predicts
+	 * half as often, 2 also gives the users other than the selected one a
+	 * single prediction a frame between them, 3 predicts a third as often
+	 * and stops classifying the others while a user is selected
+	 */
+	static const int QUALITY_LEVELS = 4;
+	/**
+	 * Users are allocated once and kept in a slot indexed by their id so
+	 * adding or removing a user never moves anyone else's state
+	 */
+	User* m_users[MAX_USER_ID+1];
+	/**
+	 * Dense list of the users in m_users so loops only visit tracked users.
+	 * m_activeIndex maps an id back to its position for O(1) removal.
+	 */
+	User* m_activeUsers[MAX_USER_ID];
+	int m_activeIndex[MAX_USER_ID+1];
+	int m_numActiveUsers;
+	/**
+	 * Users to update this frame and the skeletons to feed them, filled
+	 * before handing the work to the worker pool
+	 */
+	User* m_pendingUsers[MAX_USER_ID];
+	const UserSkeleton* m_pendingSkeletons[MAX_USER_ID];
+	bool m_pendingPredict[MAX_USER_ID];
+	XnUInt64 m_pendingTime;
+	SkeletonFrame m_frame;
+	/**
+	 * Users are updated once per 1/30 s grid point, whatever rate the
+	 * frames arrive at, since the recognizer's window is 60 updates long
+	 */
+	FrameResampler m_resampler;
+	SkeletonFrame m_gridFrame;
+	WorkerPool m_workers;
 	std::vector<int> m_userIdsFollowing;
 	int m_selectedUserId;
-	bool updateUserPosition(int id, XnVector3D torso, XnVector3D leftShoulder, XnVector3D rightShoulder, XnVector3D leftElbow,XnVector3D rightElbow, XnVector3D leftHand, XnVector3D rightHand, XnUInt64 newTime);
+	/**
+	 * Predictions a frame for the users other than the selected one (0 for
+	 * no limit), handed out round robin starting at m_nextScheduledId
+	 */
+	int m_predictionBudget;
+	int m_nextScheduledId;
+	const EarlyDetector* m_earlyDetector;
+	int m_stride;
+	GestureSmoothing m_smoothing;
+	int m_smoothingWindow;
+	double m_hysteresis;
+	int m_onsetFrames;
+	int m_releaseFrames;
+	int m_holdFrames;
+	double m_idleThreshold;
+	const struct svm_model* m_gestureGate;
+	/**
+	 * Trades classification for frame time when frames run over budget,
+	 * only while m_qualityControl is on
+	 */
+	QualityController m_quality;
+	bool m_qualityControl;
+	/**
+	 * Predictions of users that are gone, getPredictionStats adds the
+	 * current users'
+	 */
+	GesturePredictionStats m_removedStats;
+	/**
+	 * Where gesture events go: every listener, and the queue if it has a
+	 * capacity (the oldest events are dropped when it is full)
+	 */
+	std::vector<GestureListener> m_gestureListeners;
+	std::deque<GestureEvent> m_gestureQueue;
+	size_t m_gestureQueueCapacity;
+	User* getUser(int id);
+	void init();
+	static void updatePendingUser(void* pCookie, int index);
+	int effectiveStride() const;
+	void applyQuality();
+	void scheduleUsers(int nPending);
+	void updateUsers(const SkeletonFrame& frame);
+	void updateUsersResampled(const SkeletonFrame& frame);
+	void dispatchGestureEvents(const GestureEvent* events, int count);
+	UserTracking(const UserTracking& other) = delete;
+	UserTracking& operator=(const UserTracking& other) = delete;
 	public:
 	UserTracking();
+	UserTracking(int numWorkerThreads);
 	~UserTracking();
 	
 	/** Debug *************************/
@@ -39,8 +140,28 @@ private:
 	bool addKinectUser(int id);
 	bool removeKinectUser(int id);
 	bool clearSelectedUser();
+	bool selectUser(int id);
+	void setPredictionBudget(int predictions);
 	
 	XnStatus updateAllData(xn::UserGenerator * userGenerator);
+	XnStatus updateAllData(const SkeletonFrame& frame);
+	XnStatus updateAllData(SkeletonSource* source);
+	FrameResamplerStats getResamplerStats() const;
+	void setEarlyDetector(const EarlyDetector* detector);
+	void setGestureSmoothing(int stride, GestureSmoothing mode, int window, double hysteresis);
+	void setIdleGate(double threshold);
+	void setGestureGate(const struct svm_model* gate);
+	GesturePredictionStats getPredictionStats() const;
+	void setFrameBudget(double ms);
+	QualityStats getQualityStats() const;
+	void printQualityStats(FILE* file) const;
+
+	/** Gesture events ****************/
+	void setGestureDebounce(int onsetFrames, int releaseFrames, int holdFrames);
+	void addGestureListener(GestureCallback callback, void* pCookie, int userId = 0);
+	void removeGestureListener(GestureCallback callback, void* pCookie);
+	void setGestureQueueCapacity(size_t capacity);
+	bool pollGestureEvent(GestureEvent& event);
 
 };
 
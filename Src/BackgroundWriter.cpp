@@ -0,0 +1,189 @@
+/******************************************************************************
+ * BackgroundWriter.cpp
+ *
+ * Double buffered file writer running on its own thread.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "BackgroundWriter.h"
+#include <chrono>
+#include <string.h>
+
+/**
+ * Write rate while the writer thread was busy
+ */
+double BackgroundWriterStats::MegabytesPerSecond() const
+{
+	if(busySeconds<=0)
+	{
+		return 0.0;
+	}
+	return bytesWritten/busySeconds/1000000.0;
+}
+
+/**
+ * Constructor
+ */
+BackgroundWriter::BackgroundWriter()
+{
+	file=NULL;
+	writing=false;
+	stopping=false;
+	memset(&stats,0,sizeof(stats));
+}
+
+/**
+ * Destructor, writes anything still buffered
+ */
+BackgroundWriter::~BackgroundWriter()
+{
+	Close();
+}
+
+/**
+ * Open a file and start the writer thread
+ * @param mode fopen mode, e.g. "wb"
+ */
+bool BackgroundWriter::Open(const char* path, const char* mode)
+{
+	Close();
+	file=fopen(path,mode);
+	if(file==NULL)
+	{
+		fprintf(stderr, "Can't open %s for writing\n", path);
+		return false;
+	}
+	stopping=false;
+	memset(&stats,0,sizeof(stats));
+	thread = std::thread(&BackgroundWriter::WriterLoop,this);
+	return true;
+}
+
+/**
+ * Is a file open
+ */
+bool BackgroundWriter::IsOpen() const
+{
+	return file!=NULL;
+}
+
+/**
+ * Queue bytes to be written. Only copies them into memory, never touches
+ * the disk, and may be called from any thread.
+ */
+void BackgroundWriter::Write(const void* data, size_t size)
+{
+	Write(data,size,NULL,0);
+}
+
+/**
+ * Queue two pieces of data that have to stay together (e.g. a header and
+ * its payload) without the caller copying them into one block first
+ */
+void BackgroundWriter::Write(const void* first, size_t firstSize, const void* second, size_t secondSize)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		front.insert(front.end(), (const char*)first, (const char*)first+firstSize);
+		if(secondSize>0)
+		{
+			front.insert(front.end(), (const char*)second, (const char*)second+secondSize);
+		}
+		stats.bytesQueued+=firstSize+secondSize;
+		if(front.size()>stats.maxPendingBytes)
+		{
+			stats.maxPendingBytes=front.size();
+		}
+	}
+	wake.notify_one();
+}
+
+/**
+ * Wait until everything written so far has reached the file
+ */
+void BackgroundWriter::Flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while(file!=NULL && (writing || !front.empty()))
+	{
+		wake.notify_one();
+		idle.wait(lock);
+	}
+}
+
+/**
+ * Write anything buffered, stop the thread and close the file
+ */
+void BackgroundWriter::Close()
+{
+	if(file==NULL)
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping=true;
+	}
+	wake.notify_one();
+	thread.join();
+	fclose(file);
+	file=NULL;
+}
+
+/**
+ * Body of the writer thread
+ */
+void BackgroundWriter::WriterLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while(true)
+	{
+		while(front.empty() && !stopping)
+		{
+			wake.wait(lock);
+		}
+		if(front.empty() && stopping)
+		{
+			return;
+		}
+		// take the filled buffer and let callers keep writing into the other
+		front.swap(back);
+		writing=true;
+		stats.batches++;
+		lock.unlock();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		size_t written = WriteBatch(&back[0],back.size(),file);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+		back.clear();
+		lock.lock();
+		stats.bytesWritten+=written;
+		stats.busySeconds+=seconds;
+		writing=false;
+		if(front.empty())
+		{
+			fflush(file);
+			idle.notify_all();
+		}
+	}
+}
+
+/**
+ * Writes one batch of queued bytes, runs on the writer thread
+ * @return number of bytes that went to the file
+ */
+size_t BackgroundWriter::WriteBatch(const char* data, size_t size, FILE* file)
+{
+	return fwrite(data,1,size,file);
+}
+
+/**
+ * Counters for throughput and how far behind the writer is
+ */
+BackgroundWriterStats BackgroundWriter::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	BackgroundWriterStats current = stats;
+	current.pendingBytes = front.size();
+	return current;
+}
@@ -0,0 +1,73 @@
+/*************************************************
+ * BackgroundWriter.h
+ *
+ * Writes to a file from a background thread so the capture loop never
+ * waits on the disk. Callers append bytes to a front buffer; the writer
+ * thread swaps it with a back buffer and writes that out while the next
+ * one fills. Both buffers keep their capacity, so once warmed up writing
+ * does not allocate.
+ *
+ * Subclasses can override WriteBatch to turn what was queued into what
+ * goes in the file (e.g. format numbers) on the writer thread. They must
+ * call Close() in their own destructor so that the last batch is still
+ * handled by their override.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef BACKGROUND_WRITER_H
+#define BACKGROUND_WRITER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+struct BackgroundWriterStats
+{
+	unsigned long long bytesQueued; // passed to Write
+	unsigned long long bytesWritten; // written to the file
+	unsigned long long batches; // buffer swaps
+	size_t pendingBytes; // queued but not yet handed to the writer thread
+	size_t maxPendingBytes;
+	double busySeconds; // time the writer thread spent writing
+
+	double MegabytesPerSecond() const;
+};
+
+class BackgroundWriter
+{
+private:
+	FILE* file;
+	std::thread thread;
+	mutable std::mutex mutex;
+	std::condition_variable wake; // data was added or we are closing
+	std::condition_variable idle; // the writer finished a batch
+	std::vector<char> front; // being filled by Write
+	std::vector<char> back; // being written by the thread
+	bool writing;
+	bool stopping;
+	BackgroundWriterStats stats;
+
+	void WriterLoop();
+
+protected:
+	virtual size_t WriteBatch(const char* data, size_t size, FILE* file);
+
+public:
+	BackgroundWriter();
+	virtual ~BackgroundWriter();
+	BackgroundWriter(const BackgroundWriter& other) = delete;
+	BackgroundWriter& operator=(const BackgroundWriter& other) = delete;
+
+	bool Open(const char* path, const char* mode);
+	bool IsOpen() const;
+	void Write(const void* data, size_t size);
+	void Write(const void* first, size_t firstSize, const void* second, size_t secondSize);
+	void Flush();
+	void Close();
+	BackgroundWriterStats GetStats() const;
+};
+
+#endif
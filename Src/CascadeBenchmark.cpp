@@ -0,0 +1,140 @@
+/************************************************
+ * CascadeBenchmark.cpp
+ *
+ * Measures what a cascade (GestureRecognizerBase::SetGate) saves and what
+ * it costs in accuracy. Every sample of a labeled LIBSVM file is replayed
+ * frame by frame after a background sample from the same file, as in
+ * StrideBenchmark, once with the full model alone and once behind the gate.
+ *
+ * Reports the accuracy at the end of every sample, how many predictions
+ * the gate rejected, how many sample windows it wrongly rejected as
+ * background and the cost per frame of the whole update.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ *
+ * Usage: ./CascadeBenchmark <samples.txt> <model.txt> <gate.txt> <backgroundLabel>
+ * ********************************************/
+
+#include "GestureRecognizer.h"
+#include "SampleReader.h"
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+struct Sample
+{
+	int label;
+	std::vector<double> values; // every feature of the window
+};
+
+/**
+ * Feed every frame of a sample to the recognizer, oldest first
+ */
+static void Replay(GestureRecognizer& recognizer, const Sample& sample)
+{
+	UserSkeleton skeleton;
+	for(int back=GestureRecognizer::WINDOW_FRAMES-1;back>=0;back--)
+	{
+		GestureRecognizer::WindowFrame(&sample.values[0],back,skeleton);
+		recognizer.UpdateFeatures(skeleton);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if(argc<5)
+	{
+		printf("Missing arguments\nUsage: ./CascadeBenchmark <samples.txt> <model.txt> <gate.txt> <backgroundLabel>\n");
+		return -1;
+	}
+	GestureRecognizer recognizer(argv[2]);
+	struct svm_model* gate=svm_load_model(argv[3]);
+	if(gate==NULL)
+	{
+		printf("Can't load the gate model %s\n",argv[3]);
+		return -1;
+	}
+	int backgroundLabel=atoi(argv[4]);
+
+	SampleReader input;
+	if(!input.Open(argv[1]))
+	{
+		return -1;
+	}
+	std::vector<Sample> samples;
+	std::vector<int> backgrounds;
+	Sample read;
+	read.values.resize(GestureRecognizer::FEATURES);
+	while(input.Read(read.label,read.values))
+	{
+		if(read.label==backgroundLabel)
+		{
+			backgrounds.push_back((int)samples.size());
+		}
+		samples.push_back(read);
+	}
+	if(samples.empty())
+	{
+		printf("No samples in %s\n",argv[1]);
+		return -1;
+	}
+
+	int total=(int)samples.size();
+	printf("%d samples, %d of them background, the model has %d support vectors and the gate %d\n",total,
+			(int)backgrounds.size(),svm_get_nr_sv(recognizer.GetModel()),svm_get_nr_sv(gate));
+	for(int cascade=0;cascade<2;cascade++)
+	{
+		recognizer.SetGate(cascade ? gate : NULL);
+		GesturePredictionStats before=recognizer.GetPredictionStats();
+		int correct=0, gesturesRejected=0, backgroundRejected=0;
+		long frames=0;
+		double seconds=0.0;
+		int nextBackground=0;
+		for(int n=0;n<total;n++)
+		{
+			const Sample* leadIn=NULL;
+			for(size_t tries=0;tries<backgrounds.size() && leadIn==NULL;tries++)
+			{
+				int b=backgrounds[nextBackground++%backgrounds.size()];
+				if(b!=n)
+				{
+					leadIn=&samples[b];
+				}
+			}
+			clock_t start=clock();
+			if(leadIn!=NULL)
+			{
+				Replay(recognizer,*leadIn);
+				frames+=GestureRecognizer::WINDOW_FRAMES;
+			}
+			Replay(recognizer,samples[n]);
+			frames+=GestureRecognizer::WINDOW_FRAMES;
+			seconds+=(clock()-start)/(double)CLOCKS_PER_SEC;
+			if(recognizer.GetGesture()==samples[n].label)
+			{
+				correct++;
+			}
+			// would the gate reject the window of just this sample
+			bool rejected=cascade && (int)svm_predict(gate,recognizer.GetFeatures())==backgroundLabel;
+			if(rejected && samples[n].label==backgroundLabel)
+			{
+				backgroundRejected++;
+			}
+			else if(rejected)
+			{
+				gesturesRejected++;
+			}
+		}
+		GesturePredictionStats after=recognizer.GetPredictionStats();
+		XnUInt64 predictions=after.predictions-before.predictions;
+		printf("%s: %.1f%% correct, %.1f%% of predictions rejected by the gate, %.1f us per frame\n",
+				cascade ? "Cascade" : "Full model",100.0*correct/total,
+				predictions>0 ? 100.0*(after.rejected-before.rejected)/predictions : 0.0,1e6*seconds/frames);
+		if(cascade)
+		{
+			printf("Sample windows rejected: %d of %d background, %d of %d gestures\n",backgroundRejected,
+					(int)backgrounds.size(),gesturesRejected,total-(int)backgrounds.size());
+		}
+	}
+	svm_free_and_destroy_model(&gate);
+	return 0;
+}
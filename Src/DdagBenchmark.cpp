@@ -0,0 +1,154 @@
+/************************************************
+ * DdagBenchmark.cpp
+ *
+ * Compares decision DAG prediction (svm_predict_ddag) with LIBSVM's max
+ * wins voting on the samples of a labeled LIBSVM file: the accuracy of
+ * each, how often they agree, how many kernel values each computes and
+ * what a prediction costs. Every sample is predicted -r times for the
+ * timings.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ *
+ * Usage: ./DdagBenchmark <samples.txt> <model.txt> [-r repeats]
+ * ********************************************/
+
+#include "SampleReader.h"
+#include "svm.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+/**
+ * How many kernel values the DAG needed for the decisions it made: the
+ * support vectors with a nonzero coefficient in any of them. Walks the DAG
+ * again over its decision values.
+ */
+static int DagKernels(const struct svm_model* model, const double* decisions)
+{
+	int nrClass=model->nr_class;
+	std::vector<int> start(nrClass,0);
+	for(int i=1;i<nrClass;i++)
+	{
+		start[i]=start[i-1]+model->nSV[i-1];
+	}
+	std::vector<bool> needed(model->l,false);
+	int first=0;
+	int last=nrClass-1;
+	while(first<last)
+	{
+		for(int k=start[first];k<start[first]+model->nSV[first];k++)
+		{
+			needed[k]=needed[k] || model->sv_coef[last-1][k]!=0;
+		}
+		for(int k=start[last];k<start[last]+model->nSV[last];k++)
+		{
+			needed[k]=needed[k] || model->sv_coef[first][k]!=0;
+		}
+		int p=first*(2*nrClass-first-1)/2+(last-first-1);
+		if(decisions[p]>0)
+		{
+			last--;
+		}
+		else
+		{
+			first++;
+		}
+	}
+	int count=0;
+	for(int k=0;k<model->l;k++)
+	{
+		count+=needed[k] ? 1 : 0;
+	}
+	return count;
+}
+
+int main(int argc, char* argv[]) {
+	if(argc<3)
+	{
+		printf("Missing arguments\nUsage: ./DdagBenchmark <samples.txt> <model.txt> [-r repeats]\n");
+		return -1;
+	}
+	int repeats=10;
+	for(int i=3;i<argc;i++)
+	{
+		if(i+1<argc && strcmp(argv[i],"-r")==0)
+		{
+			repeats=atoi(argv[++i]);
+		}
+		else
+		{
+			printf("Unknown option %s\n",argv[i]);
+			return -1;
+		}
+	}
+	repeats=repeats<1 ? 1 : repeats;
+	struct svm_model* model=svm_load_model(argv[2]);
+	if(model==NULL)
+	{
+		printf("Can't load SVM model %s\n",argv[2]);
+		return -1;
+	}
+	if(svm_get_svm_type(model)!=C_SVC && svm_get_svm_type(model)!=NU_SVC)
+	{
+		printf("%s is not a classification model\n",argv[2]);
+		return -1;
+	}
+
+	SampleReader input;
+	if(!input.Open(argv[1]))
+	{
+		return -1;
+	}
+	std::vector<std::vector<struct svm_node> > samples;
+	std::vector<int> labels;
+	std::vector<struct svm_node> read;
+	int label;
+	while(input.Read(label,read))
+	{
+		samples.push_back(read);
+		labels.push_back(label);
+	}
+	if(samples.empty())
+	{
+		printf("No samples in %s\n",argv[1]);
+		return -1;
+	}
+
+	int nrClass=model->nr_class;
+	std::vector<double> decisions(nrClass*(nrClass-1)/2);
+	int total=(int)samples.size();
+	int voteCorrect=0, dagCorrect=0, agree=0;
+	long dagKernels=0;
+	double voteSeconds=0.0, dagSeconds=0.0;
+	for(int n=0;n<total;n++)
+	{
+		const struct svm_node* x=&samples[n][0];
+		int vote=0, dag=0;
+		clock_t start=clock();
+		for(int r=0;r<repeats;r++)
+		{
+			vote=(int)svm_predict_values(model,x,&decisions[0]);
+		}
+		voteSeconds+=(clock()-start)/(double)CLOCKS_PER_SEC;
+		start=clock();
+		for(int r=0;r<repeats;r++)
+		{
+			dag=(int)svm_predict_ddag_values(model,x,&decisions[0]);
+		}
+		dagSeconds+=(clock()-start)/(double)CLOCKS_PER_SEC;
+		dagKernels+=DagKernels(model,&decisions[0]);
+		voteCorrect+=vote==labels[n] ? 1 : 0;
+		dagCorrect+=dag==labels[n] ? 1 : 0;
+		agree+=vote==dag ? 1 : 0;
+	}
+	printf("%d samples, %d classes, %d support vectors\n",total,nrClass,model->l);
+	printf("Voting: %.1f%% correct, %d kernel values, %.1f us per prediction\n",100.0*voteCorrect/total,model->l,
+			1e6*voteSeconds/(total*(double)repeats));
+	printf("DAG:    %.1f%% correct, %.1f kernel values, %.1f us per prediction\n",100.0*dagCorrect/total,
+			dagKernels/(double)total,1e6*dagSeconds/(total*(double)repeats));
+	printf("Same label %.1f%% of the time, %+.1f%% accuracy with the DAG\n",100.0*agree/total,
+			100.0*(dagCorrect-voteCorrect)/total);
+	svm_free_and_destroy_model(&model);
+	return 0;
+}
@@ -0,0 +1,231 @@
+/************************************************
+ * EarlyBenchmark.cpp
+ *
+ * Measures how much sooner EarlyDetector reports gestures and what that
+ * costs in accuracy. Every sample of a labeled LIBSVM file (full windows,
+ * ideally not the ones the models were trained on) is replayed frame by
+ * frame into a GestureRecognizer. Each one is led in by a background
+ * sample (-n) from the same file, or without one by the user standing
+ * still in the sample's first pose, so the detector also gets the chance
+ * to fire before the gesture starts.
+ *
+ * Reports the accuracy of each stage on its own, at exactly its window
+ * length, and for the detector as a whole the first gesture it reports:
+ * how often it is right, wrong (including before the gesture) or silent,
+ * and how many frames into the gesture it fires, along with the cost per
+ * frame. Samples of the background class are right when nothing is
+ * reported.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ *
+ * Usage: ./EarlyBenchmark <samples.txt> <model.txt> [-n backgroundLabel] [-e frames model.txt threshold]...
+ * ********************************************/
+
+#include "EarlyDetector.h"
+#include "SampleReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+struct Sample
+{
+	int label;
+	std::vector<double> values; // every feature of the window
+};
+
+int main(int argc, char* argv[]) {
+	if(argc<3)
+	{
+		printf("Missing arguments\nUsage: ./EarlyBenchmark <samples.txt> <model.txt> [-n backgroundLabel] [-e frames model.txt threshold]...\n");
+		return -1;
+	}
+	int backgroundLabel=0;
+	for(int i=3;i+1<argc;i++)
+	{
+		if(strcmp(argv[i],"-n")==0)
+		{
+			backgroundLabel=atoi(argv[i+1]);
+		}
+	}
+	EarlyDetector detector(backgroundLabel);
+	for(int i=3;i<argc;)
+	{
+		if(strcmp(argv[i],"-n")==0 && i+1<argc)
+		{
+			i+=2;
+		}
+		else if(strcmp(argv[i],"-e")==0 && i+3<argc)
+		{
+			if(!detector.AddStage(atoi(argv[i+1]),argv[i+2],atof(argv[i+3])))
+			{
+				printf("Can't add a stage of %s frames\n",argv[i+1]);
+				return -1;
+			}
+			i+=4;
+		}
+		else
+		{
+			printf("Unknown option %s\n",argv[i]);
+			return -1;
+		}
+	}
+	GestureRecognizer recognizer(argv[2]);
+
+	SampleReader input;
+	if(!input.Open(argv[1]))
+	{
+		return -1;
+	}
+	std::vector<Sample> samples;
+	std::vector<int> backgrounds;
+	Sample read;
+	read.values.resize(GestureRecognizer::FEATURES);
+	while(input.Read(read.label,read.values))
+	{
+		if(read.label==backgroundLabel)
+		{
+			backgrounds.push_back((int)samples.size());
+		}
+		samples.push_back(read);
+	}
+	if(samples.empty())
+	{
+		printf("No samples in %s\n",argv[1]);
+		return -1;
+	}
+
+	int numStages=detector.GetNumStages();
+	std::vector<int> stageCorrect(numStages,0);
+	int gestureSamples=0;
+	int fullCorrect=0;
+	int earlyCorrect=0, earlyWrong=0, earlySilent=0, beforeGesture=0;
+	int withFallbackCorrect=0;
+	long latencyFrames=0;
+	int detected=0; // correct gesture detections, what the latency is averaged over
+	double detectSeconds=0.0, classifySeconds=0.0;
+	long frames=0;
+	int nextBackground=0;
+	// frames a sample holds, more than FRAMES if the window shifts by less than a frame
+	int windowFrames=(GestureRecognizer::FEATURES-GestureRecognizer::FRAME_FEATURES)/GestureRecognizer::SHIFT+1;
+	UserSkeleton skeleton;
+	for(size_t n=0;n<samples.size();n++)
+	{
+		const Sample& sample=samples[n];
+		bool gesture=sample.label!=backgroundLabel;
+		if(gesture)
+		{
+			gestureSamples++;
+		}
+
+		// lead in with another background sample, or standing still
+		const Sample* leadIn=NULL;
+		for(size_t tries=0;tries<backgrounds.size() && leadIn==NULL;tries++)
+		{
+			int b=backgrounds[nextBackground++%backgrounds.size()];
+			if(b!=(int)n)
+			{
+				leadIn=&samples[b];
+			}
+		}
+		EarlyDetection first;
+		first.label=0;
+		first.frames=0;
+		for(int frame=0;frame<windowFrames;frame++)
+		{
+			GestureRecognizer::WindowFrame(&(leadIn!=NULL ? *leadIn : sample).values[0],leadIn!=NULL ? windowFrames-1-frame : windowFrames-1,skeleton);
+			recognizer.UpdateFeatures(skeleton);
+			// until then the stages still see the end of the previous sample
+			if(numStages==0 || frame<detector.GetStageFrames(numStages-1))
+			{
+				continue;
+			}
+			EarlyDetection detection=detector.Detect(recognizer);
+			if(first.label==0 && detection.label!=0)
+			{
+				first=detection;
+				first.frames=0;
+			}
+		}
+
+		// the gesture starts FRAMES frames before the end of the sample
+		for(int back=windowFrames-1;back>=0;back--)
+		{
+			GestureRecognizer::WindowFrame(&sample.values[0],back,skeleton);
+			recognizer.UpdateFeatures(skeleton);
+			int seen=back<GestureRecognizer::FRAMES ? GestureRecognizer::FRAMES-back : 0;
+			for(int s=0;s<numStages;s++)
+			{
+				if(detector.GetStageFrames(s)==seen && detector.DetectStage(s,recognizer).predicted==sample.label)
+				{
+					stageCorrect[s]++;
+				}
+			}
+			clock_t start=clock();
+			EarlyDetection detection=detector.Detect(recognizer);
+			detectSeconds+=(clock()-start)/(double)CLOCKS_PER_SEC;
+			frames++;
+			if(first.label==0 && detection.label!=0)
+			{
+				first=detection;
+				first.frames=seen;
+			}
+		}
+		clock_t start=clock();
+		int full=recognizer.Classify();
+		classifySeconds+=(clock()-start)/(double)CLOCKS_PER_SEC;
+		if(full==sample.label)
+		{
+			fullCorrect++;
+		}
+
+		if(first.label==0)
+		{
+			earlySilent++;
+			// silence is the right answer for the background class
+			if(!gesture)
+			{
+				earlyCorrect++;
+			}
+			if(full==sample.label)
+			{
+				withFallbackCorrect++;
+			}
+		}
+		else if(first.label==sample.label && first.frames>0)
+		{
+			earlyCorrect++;
+			withFallbackCorrect++;
+			latencyFrames+=first.frames;
+			detected++;
+		}
+		else
+		{
+			earlyWrong++;
+			if(first.frames==0)
+			{
+				beforeGesture++;
+			}
+		}
+	}
+
+	int total=(int)samples.size();
+	printf("Samples: %d (%d gestures), lead in: %s\n",total,gestureSamples,backgrounds.empty() ? "first pose" : "background samples");
+	printf("Full window (%d frames, %.0f ms): %.1f%% correct\n",GestureRecognizer::FRAMES,
+			GestureRecognizer::FRAMES*1000.0/30,100.0*fullCorrect/total);
+	for(int s=0;s<numStages;s++)
+	{
+		int stageFrames=detector.GetStageFrames(s);
+		printf("Stage %d frames (%.0f ms) alone: %.1f%% correct\n",stageFrames,stageFrames*1000.0/30,100.0*stageCorrect[s]/total);
+	}
+	printf("Early detection: %.1f%% correct, %.1f%% wrong (%.1f%% before the gesture), %.1f%% silent\n",100.0*earlyCorrect/total,
+			100.0*earlyWrong/total,100.0*beforeGesture/total,100.0*earlySilent/total);
+	if(detected>0)
+	{
+		printf("Correct detections after %.1f frames (%.0f ms) of the gesture on average\n",
+				latencyFrames/(double)detected,latencyFrames*1000.0/30/detected);
+	}
+	printf("With the full window when silent: %.1f%% correct\n",100.0*withFallbackCorrect/total);
+	printf("Detect: %.1f us per frame, full window classify: %.1f us\n",1e6*detectSeconds/frames,1e6*classifySeconds/total);
+	return 0;
+}
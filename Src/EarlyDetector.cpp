@@ -0,0 +1,192 @@
+/******************************************************************************
+ * EarlyDetector.cpp
+ *
+ * Reports gestures from partial windows, shortest window first.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "EarlyDetector.h"
+#include <stdio.h>
+
+/**
+ * Constructor
+ * @param backgroundLabel the class of no gesture (e.g. NOTHING), never
+ * reported early. 0 if every class is a gesture.
+ */
+EarlyDetector::EarlyDetector(int backgroundLabel)
+{
+	numStages = 0;
+	this->backgroundLabel = backgroundLabel;
+}
+
+/**
+ * Destructor
+ */
+EarlyDetector::~EarlyDetector()
+{
+	for(int i=0;i<numStages;i++)
+	{
+		svm_free_and_destroy_model(&stages[i].model);
+	}
+}
+
+/**
+ * Add a partial window model, stages are kept shortest first
+ * @param frames how many frames the model was trained on (PartialWindows)
+ * @param pathToModel The file path to the libsvm model
+ * @param threshold confidence needed to report a gesture. For a model
+ * trained with -b 1 this is a probability, otherwise the fraction of the
+ * one-vs-one contests the class won.
+ * @return false if there is no room for another stage or the model has
+ * too many classes. Throws -1 like GestureRecognizer::LoadModel if the
+ * model can't be loaded.
+ */
+bool EarlyDetector::AddStage(int frames, char* pathToModel, double threshold)
+{
+	if(numStages==EARLY_MAX_STAGES || frames<1 || frames>GestureRecognizer::FRAMES)
+	{
+		return false;
+	}
+	struct svm_model* model = svm_load_model(pathToModel);
+	if(model==NULL)
+	{
+		fprintf(stderr, "Can't load SVM model %s", pathToModel);
+		throw -1;
+	}
+	if(svm_get_nr_class(model)>EARLY_MAX_CLASSES)
+	{
+		svm_free_and_destroy_model(&model);
+		return false;
+	}
+	int i = numStages;
+	while(i>0 && stages[i-1].frames>frames)
+	{
+		stages[i] = stages[i-1];
+		i--;
+	}
+	Stage& stage = stages[i];
+	stage.frames = frames;
+	stage.threshold = threshold;
+	stage.model = model;
+	stage.nrClass = svm_get_nr_class(model);
+	stage.probability = svm_check_probability_model(model)!=0;
+	numStages++;
+	return true;
+}
+
+int EarlyDetector::GetNumStages() const
+{
+	return numStages;
+}
+
+/**
+ * Frames of a stage, stages are numbered shortest first
+ */
+int EarlyDetector::GetStageFrames(int stage) const
+{
+	return stages[stage].frames;
+}
+
+/**
+ * Predict with one stage
+ * @param features the stage's frames, terminated by a node with index -1
+ * @param label set to the predicted class
+ * @return the confidence in that class
+ */
+double EarlyDetector::Predict(const Stage& stage, const struct svm_node* features, int* label)
+{
+	if(stage.probability)
+	{
+		double prob[EARLY_MAX_CLASSES];
+		*label = (int)svm_predict_probability(stage.model,features,prob);
+		double best = 0.0;
+		for(int i=0;i<stage.nrClass;i++)
+		{
+			if(prob[i]>best)
+			{
+				best = prob[i];
+			}
+		}
+		return best;
+	}
+	double decisions[EARLY_MAX_CLASSES*(EARLY_MAX_CLASSES-1)/2];
+	*label = (int)svm_predict_values(stage.model,features,decisions);
+	if(stage.nrClass<2)
+	{
+		return 1.0;
+	}
+	// the same one-vs-one vote svm_predict_values takes
+	int votes[EARLY_MAX_CLASSES] = {0};
+	int p = 0;
+	for(int i=0;i<stage.nrClass;i++)
+	{
+		for(int j=i+1;j<stage.nrClass;j++)
+		{
+			votes[decisions[p++]>0 ? i : j]++;
+		}
+	}
+	int winner = 0;
+	for(int i=1;i<stage.nrClass;i++)
+	{
+		if(votes[i]>votes[winner])
+		{
+			winner = i;
+		}
+	}
+	return votes[winner]/(double)(stage.nrClass-1);
+}
+
+/**
+ * Evaluate one stage on the last frames of the recognizer's window
+ * @return the stage's prediction, label 0 if the window doesn't hold enough
+ * frames yet, the newest frame was not fit to classify, the prediction is
+ * the background class or it isn't confident enough
+ */
+EarlyDetection EarlyDetector::DetectStage(int stage, const GestureRecognizer& recognizer) const
+{
+	EarlyDetection detection;
+	detection.label = 0;
+	detection.predicted = 0;
+	detection.frames = stages[stage].frames;
+	detection.confidence = 0.0;
+	if(recognizer.GetNumberOfFrames()<stages[stage].frames || !recognizer.IsClassifiable())
+	{
+		return detection;
+	}
+	// the model's feature indices start where its frames are in the window
+	const struct svm_node* features = recognizer.GetFeatures()+
+			GestureRecognizer::FrameOffset(stages[stage].frames-1);
+	detection.confidence = Predict(stages[stage],features,&detection.predicted);
+	if(detection.predicted!=backgroundLabel && detection.confidence>=stages[stage].threshold)
+	{
+		detection.label = detection.predicted;
+	}
+	return detection;
+}
+
+/**
+ * Evaluate the stages shortest first and report the first confident one
+ * @return label 0 if no stage reported a gesture
+ */
+EarlyDetection EarlyDetector::Detect(const GestureRecognizer& recognizer) const
+{
+	EarlyDetection detection;
+	detection.label = 0;
+	detection.predicted = 0;
+	detection.frames = 0;
+	detection.confidence = 0.0;
+	for(int i=0;i<numStages;i++)
+	{
+		if(recognizer.GetNumberOfFrames()<stages[i].frames)
+		{
+			break;
+		}
+		detection = DetectStage(i,recognizer);
+		if(detection.label!=0)
+		{
+			break;
+		}
+	}
+	return detection;
+}
@@ -0,0 +1,64 @@
+/*************************************************
+ * EarlyDetector.h
+ *
+ * Reports a gesture before the recognizer's 2 second window is full of it.
+ * Each stage is a model trained on only the first few frames of every
+ * sample (see PartialWindows). Since the recognizer keeps its newest frame
+ * at the end of the window, a stage trained on N frames is evaluated on the
+ * features of the last N frames, in place, as soon as the window holds N
+ * frames.
+ *
+ * Stages are tried from the shortest up and the first one sure enough of a
+ * gesture (confidence >= its threshold) reports it. The models are only
+ * read, so one detector can be shared by every user and thread.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef EARLY_DETECTOR_H
+#define EARLY_DETECTOR_H
+
+#include "GestureRecognizer.h"
+#include "svm.h"
+
+#define EARLY_MAX_STAGES 8
+#define EARLY_MAX_CLASSES 16
+
+struct EarlyDetection
+{
+	int label; // 0 if no stage was sure of a gesture
+	int predicted; // the stage's class whatever its confidence, 0 if not evaluated
+	int frames; // frames of the stage that reported it
+	double confidence;
+};
+
+class EarlyDetector
+{
+private:
+	struct Stage
+	{
+		int frames;
+		double threshold;
+		struct svm_model* model;
+		int nrClass;
+		bool probability;
+	};
+	Stage stages[EARLY_MAX_STAGES];
+	int numStages;
+	int backgroundLabel;
+
+	static double Predict(const Stage& stage, const struct svm_node* features, int* label);
+	EarlyDetector(const EarlyDetector& other) = delete;
+	EarlyDetector& operator=(const EarlyDetector& other) = delete;
+public:
+	EarlyDetector(int backgroundLabel = 0);
+	~EarlyDetector();
+
+	bool AddStage(int frames, char* pathToModel, double threshold);
+	int GetNumStages() const;
+	int GetStageFrames(int stage) const;
+	EarlyDetection Detect(const GestureRecognizer& recognizer) const;
+	EarlyDetection DetectStage(int stage, const GestureRecognizer& recognizer) const;
+};
+
+#endif
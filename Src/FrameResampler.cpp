@@ -0,0 +1,209 @@
+/******************************************************************************
+ * FrameResampler.cpp
+ *
+ * Resamples skeleton frames onto a fixed time grid.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "FrameResampler.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+/**
+ * Constructor
+ * @param rateHz frames per second of the output grid
+ * @param maxGapUs longest time between two captured frames that is still
+ * interpolated. Across a longer gap (tracking lost, sensor stalled) the grid
+ * restarts at the next frame instead of inventing the motion in between.
+ */
+FrameResampler::FrameResampler(double rateHz, XnUInt64 maxGapUs)
+{
+	period = 1000000.0/rateHz;
+	maxGap = maxGapUs;
+	Reset();
+}
+
+/**
+ * Forget every frame pushed so far and clear the stats
+ */
+void FrameResampler::Reset()
+{
+	hasPrevious = false;
+	hasCurrent = false;
+	gridStart = 0;
+	gridIndex = 0;
+	stats.framesIn = 0;
+	stats.framesOut = 0;
+	stats.duplicates = 0;
+	stats.gaps = 0;
+}
+
+XnUInt64 FrameResampler::GridTime(XnUInt64 index) const
+{
+	return gridStart + (XnUInt64)(index*period + 0.5);
+}
+
+/**
+ * Start a new grid whose first point is the given frame
+ */
+void FrameResampler::RestartGrid(const SkeletonFrame& frame)
+{
+	current = frame;
+	hasCurrent = true;
+	hasPrevious = false;
+	gridStart = frame.timestamp;
+	gridIndex = 0;
+}
+
+/**
+ * Pair every user in the current frame with the same user in the previous one
+ */
+void FrameResampler::MatchUsers()
+{
+	for(int i=0;i<current.nUsers;i++)
+	{
+		previousIndex[i] = -1;
+		for(int j=0;j<previous.nUsers;j++)
+		{
+			if(previous.users[j].id==current.users[i].id)
+			{
+				previousIndex[i] = j;
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * Add a captured frame. Call Next until it returns false before pushing the
+ * following frame, grid points that were not taken are skipped.
+ * A frame with the same timestamp as the last one is ignored.
+ */
+void FrameResampler::Push(const SkeletonFrame& frame)
+{
+	stats.framesIn++;
+	if(!hasCurrent)
+	{
+		RestartGrid(frame);
+		return;
+	}
+	if(frame.timestamp==current.timestamp)
+	{
+		stats.duplicates++;
+		return;
+	}
+	// a long gap, or time going backwards when a replay or sensor restarts
+	if(frame.timestamp<current.timestamp || frame.timestamp-current.timestamp>maxGap)
+	{
+		stats.gaps++;
+		RestartGrid(frame);
+		return;
+	}
+	previous = current;
+	current = frame;
+	hasPrevious = true;
+	MatchUsers();
+	// skip grid points that were never taken
+	while(GridTime(gridIndex)<=previous.timestamp)
+	{
+		gridIndex++;
+	}
+}
+
+/**
+ * Get the next grid frame that lies at or before the newest captured frame
+ *
+ * The frame's timestamp is the grid time, the other fields come from the
+ * first captured frame at or after it. Users present in both captured
+ * frames are interpolated, users that just appeared are copied as is.
+ * @return false once the grid has caught up with the captured frames
+ */
+bool FrameResampler::Next(SkeletonFrame& frame)
+{
+	if(!hasCurrent)
+	{
+		return false;
+	}
+	XnUInt64 time = GridTime(gridIndex);
+	if(time>current.timestamp)
+	{
+		return false;
+	}
+	frame.timestamp = time;
+	frame.frameId = current.frameId;
+	frame.sequence = current.sequence;
+	frame.captureTime = current.captureTime;
+	frame.nUsers = current.nUsers;
+	if(!hasPrevious)
+	{
+		for(int i=0;i<current.nUsers;i++)
+		{
+			frame.users[i] = current.users[i];
+		}
+	}
+	else
+	{
+		float t = (float)(time-previous.timestamp)/(float)(current.timestamp-previous.timestamp);
+		for(int i=0;i<current.nUsers;i++)
+		{
+			if(previousIndex[i]<0)
+			{
+				frame.users[i] = current.users[i];
+			}
+			else
+			{
+				Interpolate(previous.users[previousIndex[i]],current.users[i],t,frame.users[i]);
+			}
+		}
+	}
+	gridIndex++;
+	stats.framesOut++;
+	return true;
+}
+
+/**
+ * @return frames per second of the output grid
+ */
+double FrameResampler::GetRate() const
+{
+	return 1000000.0/period;
+}
+
+FrameResamplerStats FrameResampler::GetStats() const
+{
+	return stats;
+}
+
+/**
+ * out = from + (to-from)*t for every joint coordinate, four joints at a
+ * time on each axis.
+ * A joint is only valid in out if it was valid at both ends.
+ * @param t 0 gives from, 1 gives to
+ */
+void FrameResampler::Interpolate(const UserSkeleton& from, const UserSkeleton& to, float t, UserSkeleton& out)
+{
+	const float* a[3] = {from.x,from.y,from.z};
+	const float* b[3] = {to.x,to.y,to.z};
+	float* result[3] = {out.x,out.y,out.z};
+	for(int axis=0;axis<3;axis++)
+	{
+#ifdef __SSE__
+		__m128 weight = _mm_set1_ps(t);
+		for(int j=0;j<SKELETON_JOINT_LANES;j+=4)
+		{
+			__m128 va = _mm_load_ps(a[axis]+j);
+			__m128 vb = _mm_load_ps(b[axis]+j);
+			_mm_store_ps(result[axis]+j,_mm_add_ps(va,_mm_mul_ps(_mm_sub_ps(vb,va),weight)));
+		}
+#else
+		for(int j=0;j<SKELETON_JOINT_LANES;j++)
+		{
+			result[axis][j] = a[axis][j]+(b[axis][j]-a[axis][j])*t;
+		}
+#endif
+	}
+	out.id = to.id;
+	out.validJoints = from.validJoints & to.validJoints;
+}
@@ -0,0 +1,68 @@
+/*************************************************
+ * FrameResampler.h
+ *
+ * The recognizer's 60 frame window assumes one update every 1/30 s. The
+ * sensor does not guarantee that: frames get dropped when the host is busy
+ * and WaitAndUpdateAll can hand back the same frame twice. The resampler
+ * takes skeleton frames at whatever times they arrive and turns them into
+ * frames on a fixed time grid by linearly interpolating every joint between
+ * the two captured frames around each grid point.
+ *
+ * Usage:
+ *   resampler.Push(captured);
+ *   while(resampler.Next(frame)) { ... one update per grid point ... }
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef FRAME_RESAMPLER_H
+#define FRAME_RESAMPLER_H
+
+#include "SkeletonFrame.h"
+
+#define RESAMPLER_DEFAULT_RATE 30.0
+#define RESAMPLER_DEFAULT_MAX_GAP 250000 // microseconds
+
+struct FrameResamplerStats
+{
+	XnUInt64 framesIn; // frames given to Push
+	XnUInt64 framesOut; // grid frames returned by Next
+	XnUInt64 duplicates; // frames ignored because time did not advance
+	XnUInt64 gaps; // times the grid restarted after a long gap
+};
+
+class FrameResampler
+{
+private:
+	double period; // microseconds between grid points
+	XnUInt64 maxGap;
+	SkeletonFrame previous;
+	SkeletonFrame current;
+	/**
+	 * For each user in current, their index in previous or -1 if they
+	 * just appeared
+	 */
+	int previousIndex[SKELETON_MAX_USERS];
+	bool hasPrevious;
+	bool hasCurrent;
+	/**
+	 * Grid points are gridStart + gridIndex*period so rounding never
+	 * accumulates
+	 */
+	XnUInt64 gridStart;
+	XnUInt64 gridIndex;
+	FrameResamplerStats stats;
+	XnUInt64 GridTime(XnUInt64 index) const;
+	void RestartGrid(const SkeletonFrame& frame);
+	void MatchUsers();
+public:
+	FrameResampler(double rateHz = RESAMPLER_DEFAULT_RATE, XnUInt64 maxGapUs = RESAMPLER_DEFAULT_MAX_GAP);
+	void Reset();
+	void Push(const SkeletonFrame& frame);
+	bool Next(SkeletonFrame& frame);
+	double GetRate() const;
+	FrameResamplerStats GetStats() const;
+	static void Interpolate(const UserSkeleton& from, const UserSkeleton& to, float t, UserSkeleton& out);
+};
+
+#endif
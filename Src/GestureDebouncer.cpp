@@ -0,0 +1,122 @@
+/******************************************************************************
+ * GestureDebouncer.cpp
+ *
+ * Turns per-frame gestures into onset, hold and release events.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "GestureDebouncer.h"
+
+/**
+ * Constructor
+ * @param onsetFrames frames in a row a gesture must be seen before its onset
+ * @param releaseFrames frames in a row it must be gone before its release
+ * @param holdFrames frames between hold events, 0 for none
+ * @param backgroundLabel the class of no gesture (e.g. NOTHING), never an
+ * event. 0 if every class is a gesture.
+ */
+GestureDebouncer::GestureDebouncer(int onsetFrames, int releaseFrames, int holdFrames, int backgroundLabel)
+{
+	this->onsetFrames = onsetFrames<1 ? 1 : onsetFrames;
+	this->releaseFrames = releaseFrames<1 ? 1 : releaseFrames;
+	this->holdFrames = holdFrames<0 ? 0 : holdFrames;
+	this->backgroundLabel = backgroundLabel;
+	active = 0;
+	heldFrames = 0;
+	absentFrames = 0;
+	candidate = 0;
+	candidateFrames = 0;
+}
+
+GestureEvent GestureDebouncer::Event(GestureEventType type, int label, int frames)
+{
+	GestureEvent event;
+	event.type = type;
+	event.label = label;
+	event.frames = frames;
+	event.userId = 0;
+	event.timestamp = 0;
+	return event;
+}
+
+/**
+ * Take the next frame's gesture
+ * @param label the frame's gesture, 0 if there is none
+ * @param events room for GESTURE_MAX_EVENTS, set to what the frame caused
+ * @return how many events the frame caused
+ */
+int GestureDebouncer::Update(int label, GestureEvent* events)
+{
+	int numEvents = 0;
+	if(label==0 || label==backgroundLabel)
+	{
+		candidate = 0;
+		candidateFrames = 0;
+	}
+	else if(label==candidate)
+	{
+		candidateFrames++;
+	}
+	else
+	{
+		candidate = label;
+		candidateFrames = 1;
+	}
+
+	if(active!=0)
+	{
+		heldFrames++;
+		if(label==active)
+		{
+			absentFrames = 0;
+			if(holdFrames>0 && heldFrames%holdFrames==0)
+			{
+				events[numEvents++] = Event(GESTURE_HOLD,active,heldFrames);
+			}
+		}
+		else if(++absentFrames>=releaseFrames)
+		{
+			events[numEvents++] = Event(GESTURE_RELEASE,active,heldFrames-absentFrames);
+			active = 0;
+		}
+	}
+	// a new gesture can start the frame the old one is released
+	if(active==0 && candidate!=0 && candidateFrames>=onsetFrames)
+	{
+		active = candidate;
+		heldFrames = candidateFrames;
+		absentFrames = 0;
+		events[numEvents++] = Event(GESTURE_ONSET,active,heldFrames);
+	}
+	return numEvents;
+}
+
+/**
+ * Forget the gesture, use when the user is lost
+ * @param events room for GESTURE_MAX_EVENTS, set to the release of the
+ * gesture in progress if there is one
+ * @return how many events there are
+ */
+int GestureDebouncer::Reset(GestureEvent* events)
+{
+	int numEvents = 0;
+	if(active!=0)
+	{
+		events[numEvents++] = Event(GESTURE_RELEASE,active,heldFrames-absentFrames);
+	}
+	active = 0;
+	heldFrames = 0;
+	absentFrames = 0;
+	candidate = 0;
+	candidateFrames = 0;
+	return numEvents;
+}
+
+/**
+ * The gesture in progress, 0 if none
+ */
+int GestureDebouncer::GetGesture() const
+{
+	return active;
+}
@@ -0,0 +1,63 @@
+/*************************************************
+ * GestureDebouncer.h
+ *
+ * Turns one user's per-frame gesture into events: onset when a gesture
+ * starts, hold every so often while it lasts and release when it ends. A
+ * gesture has to be seen for a few frames in a row before its onset and be
+ * gone for a few frames before its release, so a stray frame neither
+ * starts nor ends one. Consumers only do work when something changes.
+ *
+ * One debouncer per tracked user since it remembers that user's gesture.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef GESTURE_DEBOUNCER_H
+#define GESTURE_DEBOUNCER_H
+
+#include <XnOpenNI.h>
+
+#define GESTURE_DEFAULT_ONSET_FRAMES 3
+#define GESTURE_DEFAULT_RELEASE_FRAMES 5
+#define GESTURE_DEFAULT_HOLD_FRAMES 30 // a second at 30 Hz
+#define GESTURE_MAX_EVENTS 2 // events one frame can cause, a release and an onset
+
+enum GestureEventType
+{
+	GESTURE_ONSET,
+	GESTURE_HOLD,
+	GESTURE_RELEASE
+};
+
+struct GestureEvent
+{
+	GestureEventType type;
+	int label;
+	int frames; // how long the gesture has been seen, counting its onset frames
+	int userId;
+	XnUInt64 timestamp; // of the frame that caused the event
+};
+
+class GestureDebouncer
+{
+private:
+	int onsetFrames;
+	int releaseFrames;
+	int holdFrames;
+	int backgroundLabel;
+	int active; // the gesture in progress, 0 if none
+	int heldFrames;
+	int absentFrames; // frames in a row without the active gesture
+	int candidate; // the latest label and how many frames in a row it was seen
+	int candidateFrames;
+
+	static GestureEvent Event(GestureEventType type, int label, int frames);
+public:
+	GestureDebouncer(int onsetFrames = GESTURE_DEFAULT_ONSET_FRAMES, int releaseFrames = GESTURE_DEFAULT_RELEASE_FRAMES,
+			int holdFrames = GESTURE_DEFAULT_HOLD_FRAMES, int backgroundLabel = 0);
+	int Update(int label, GestureEvent* events);
+	int Reset(GestureEvent* events);
+	int GetGesture() const;
+};
+
+#endif
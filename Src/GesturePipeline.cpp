@@ -0,0 +1,244 @@
+/******************************************************************************
+ * GesturePipeline.cpp
+ *
+ * Capture thread / recognition thread split of the main loop.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "GesturePipeline.h"
+#include <chrono>
+#include <stdio.h>
+
+/**
+ * Average latency in milliseconds
+ */
+double PipelineStageStats::AverageMs() const
+{
+	if(count==0)
+	{
+		return 0.0;
+	}
+	return totalNs/(double)count/1000000.0;
+}
+
+/**
+ * Worst latency in milliseconds
+ */
+double PipelineStageStats::MaxMs() const
+{
+	return maxNs/1000000.0;
+}
+
+GesturePipeline::LatencyCounter::LatencyCounter()
+{
+	count=0;
+	totalNs=0;
+	maxNs=0;
+}
+
+/**
+ * Record one measurement
+ */
+void GesturePipeline::LatencyCounter::Add(XnUInt64 ns)
+{
+	count.fetch_add(1, std::memory_order_relaxed);
+	totalNs.fetch_add(ns, std::memory_order_relaxed);
+	XnUInt64 max = maxNs.load(std::memory_order_relaxed);
+	while(ns>max && !maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+	{
+	}
+}
+
+PipelineStageStats GesturePipeline::LatencyCounter::Snapshot() const
+{
+	PipelineStageStats stats;
+	stats.count = count.load(std::memory_order_relaxed);
+	stats.totalNs = totalNs.load(std::memory_order_relaxed);
+	stats.maxNs = maxNs.load(std::memory_order_relaxed);
+	return stats;
+}
+
+/**
+ * Constructor
+ * @param capacity number of frames the queue can hold
+ * @param backpressure what to do when the queue is full
+ */
+GesturePipeline::GesturePipeline(int capacity, Backpressure backpressure)
+	: queue(capacity)
+{
+	this->backpressure=backpressure;
+	running=false;
+	captureStatus=XN_STATUS_OK;
+	capture=NULL;
+	captureCookie=NULL;
+	framesCaptured=0;
+	framesDropped=0;
+	framesProcessed=0;
+}
+
+/**
+ * Destructor
+ */
+GesturePipeline::~GesturePipeline()
+{
+	Stop();
+}
+
+/**
+ * Host steady clock in nanoseconds
+ */
+XnUInt64 GesturePipeline::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Start the capture thread
+ * @param capture called in a loop on the capture thread to read frames
+ * @param pCookie passed to capture
+ */
+void GesturePipeline::Start(CaptureFunction capture, void* pCookie)
+{
+	if(running)
+	{
+		return;
+	}
+	this->capture=capture;
+	this->captureCookie=pCookie;
+	captureStatus=XN_STATUS_OK;
+	running=true;
+	captureThread = std::thread(&GesturePipeline::CaptureLoop,this);
+}
+
+/**
+ * Stop the capture thread and wait for it to exit
+ */
+void GesturePipeline::Stop()
+{
+	running=false;
+	if(captureThread.joinable())
+	{
+		captureThread.join();
+	}
+}
+
+/**
+ * Is the capture thread still producing frames
+ */
+bool GesturePipeline::IsRunning() const
+{
+	return running;
+}
+
+/**
+ * The error that stopped the capture thread, XN_STATUS_OK if none
+ */
+XnStatus GesturePipeline::GetCaptureStatus() const
+{
+	return captureStatus;
+}
+
+/**
+ * Body of the capture thread
+ */
+void GesturePipeline::CaptureLoop()
+{
+	SkeletonFrame frame;
+	while(running)
+	{
+		XnUInt64 start = Now();
+		XnStatus nRetVal = capture(captureCookie, frame);
+		if(nRetVal != XN_STATUS_OK)
+		{
+			captureStatus=nRetVal;
+			running=false;
+			return;
+		}
+		frame.captureTime = Now();
+		captureLatency.Add(frame.captureTime-start);
+		framesCaptured.fetch_add(1, std::memory_order_relaxed);
+		if(backpressure==DROP_OLDEST)
+		{
+			if(queue.PushDropOldest(frame))
+			{
+				framesDropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		else
+		{
+			while(!queue.TryPush(frame) && running)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+}
+
+/**
+ * Recognition side: wait for the next frame and run recognize on it
+ * @param timeoutMs how long to wait for a frame
+ * @return false if no frame arrived in time
+ */
+bool GesturePipeline::ProcessFrame(RecognizeFunction recognize, void* pCookie, int timeoutMs)
+{
+	SkeletonFrame frame;
+	XnUInt64 deadline = Now()+(XnUInt64)timeoutMs*1000000;
+	int spins = 0;
+	while(!queue.TryPop(frame))
+	{
+		if(Now()>=deadline || (!running && queue.Size()==0))
+		{
+			return false;
+		}
+		// spin briefly, then back off so an idle pipeline does not burn a core
+		if(++spins<100)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+		}
+	}
+	XnUInt64 start = Now();
+	queueLatency.Add(start-frame.captureTime);
+	recognize(pCookie, frame);
+	XnUInt64 end = Now();
+	recognitionLatency.Add(end-start);
+	totalLatency.Add(end-frame.captureTime);
+	framesProcessed.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+/**
+ * Current counters, safe to call from any thread
+ */
+PipelineStats GesturePipeline::GetStats() const
+{
+	PipelineStats stats;
+	stats.framesCaptured = framesCaptured.load(std::memory_order_relaxed);
+	stats.framesDropped = framesDropped.load(std::memory_order_relaxed);
+	stats.framesProcessed = framesProcessed.load(std::memory_order_relaxed);
+	stats.queueDepth = queue.Size();
+	stats.capture = captureLatency.Snapshot();
+	stats.queue = queueLatency.Snapshot();
+	stats.recognition = recognitionLatency.Snapshot();
+	stats.total = totalLatency.Snapshot();
+	return stats;
+}
+
+/**
+ * Prints a summary of the counters
+ */
+void GesturePipeline::PrintStats(FILE* file) const
+{
+	PipelineStats stats = GetStats();
+	fprintf(file,"Frames captured: %llu dropped: %llu processed: %llu (queue depth %d)\n",
+			(unsigned long long)stats.framesCaptured,(unsigned long long)stats.framesDropped,
+			(unsigned long long)stats.framesProcessed,stats.queueDepth);
+	fprintf(file,"  capture     avg %7.2f ms  max %7.2f ms\n",stats.capture.AverageMs(),stats.capture.MaxMs());
+	fprintf(file,"  queue       avg %7.2f ms  max %7.2f ms\n",stats.queue.AverageMs(),stats.queue.MaxMs());
+	fprintf(file,"  recognition avg %7.2f ms  max %7.2f ms\n",stats.recognition.AverageMs(),stats.recognition.MaxMs());
+	fprintf(file,"  total       avg %7.2f ms  max %7.2f ms\n",stats.total.AverageMs(),stats.total.MaxMs());
+}
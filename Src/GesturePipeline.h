@@ -0,0 +1,120 @@
+/*************************************************
+ * GesturePipeline.h
+ *
+ * Splits the main loop into two stages so a slow classification never
+ * delays the next sensor read:
+ *
+ *   capture thread:     wait for the sensor, read the joints, push the frame
+ *   recognition thread: pop a frame, update features, classify
+ *
+ * The capture thread is owned by the pipeline. Recognition runs on whichever
+ * thread calls ProcessFrame, which is normally the program's main loop.
+ * Frames travel between the two through a bounded lock-free SpscQueue.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef GESTURE_PIPELINE_H
+#define GESTURE_PIPELINE_H
+
+#include "SkeletonFrame.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <thread>
+
+/**
+ * Latency of one pipeline stage
+ */
+struct PipelineStageStats
+{
+	XnUInt64 count;
+	XnUInt64 totalNs;
+	XnUInt64 maxNs;
+
+	double AverageMs() const;
+	double MaxMs() const;
+};
+
+struct PipelineStats
+{
+	XnUInt64 framesCaptured;
+	XnUInt64 framesDropped; // evicted when the queue was full (DROP_OLDEST)
+	XnUInt64 framesProcessed;
+	int queueDepth;
+	PipelineStageStats capture; // waiting for and reading the sensor
+	PipelineStageStats queue; // time a frame spent in the queue
+	PipelineStageStats recognition; // time spent in the recognize function
+	PipelineStageStats total; // capture to end of recognition
+};
+
+class GesturePipeline
+{
+public:
+	/**
+	 * What the capture thread does when the recognition side falls behind
+	 */
+	enum Backpressure
+	{
+		DROP_OLDEST, // evict the oldest queued frame, never stall the sensor
+		BLOCK, // wait for room, never lose a frame
+	};
+	/**
+	 * Blocks until the next frame is available and fills it in
+	 */
+	typedef XnStatus (*CaptureFunction)(void* pCookie, SkeletonFrame& frame);
+	/**
+	 * Consumes one frame on the recognition thread
+	 */
+	typedef void (*RecognizeFunction)(void* pCookie, const SkeletonFrame& frame);
+
+private:
+	/**
+	 * Lock-free average/max accumulator shared between threads
+	 */
+	class LatencyCounter
+	{
+	private:
+		std::atomic<XnUInt64> count;
+		std::atomic<XnUInt64> totalNs;
+		std::atomic<XnUInt64> maxNs;
+	public:
+		LatencyCounter();
+		void Add(XnUInt64 ns);
+		PipelineStageStats Snapshot() const;
+	};
+
+	SpscQueue<SkeletonFrame> queue;
+	Backpressure backpressure;
+	std::thread captureThread;
+	std::atomic<bool> running;
+	std::atomic<XnStatus> captureStatus;
+	CaptureFunction capture;
+	void* captureCookie;
+	std::atomic<XnUInt64> framesCaptured;
+	std::atomic<XnUInt64> framesDropped;
+	std::atomic<XnUInt64> framesProcessed;
+	LatencyCounter captureLatency;
+	LatencyCounter queueLatency;
+	LatencyCounter recognitionLatency;
+	LatencyCounter totalLatency;
+
+	void CaptureLoop();
+
+public:
+	GesturePipeline(int capacity, Backpressure backpressure);
+	~GesturePipeline();
+	GesturePipeline(const GesturePipeline& other) = delete;
+	GesturePipeline& operator=(const GesturePipeline& other) = delete;
+
+	void Start(CaptureFunction capture, void* pCookie);
+	void Stop();
+	bool ProcessFrame(RecognizeFunction recognize, void* pCookie, int timeoutMs);
+	bool IsRunning() const;
+	XnStatus GetCaptureStatus() const;
+	PipelineStats GetStats() const;
+	void PrintStats(FILE* file) const;
+
+	static XnUInt64 Now();
+};
+
+#endif
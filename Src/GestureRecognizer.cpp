@@ -3,58 +3,47 @@
  * 
  * Used to classify gestures in real-time using OpenNI and LIBSVM
  * 
- * Uses an array of 1080 features which are updated with each new frame of 
- * data from the Kinect.
+ * The model handling shared by every BasicGestureRecognizer, the feature
+ * window itself is in GestureRecognizer.h.
  * 
  * Author: Aaron Pulver <atp1317@rit.edu>
  * **************************************************************************/
 
 #include "GestureRecognizer.h"
 #include "svm.h"
+#include <string.h>
+#include <charconv>
+#include <chrono>
+#include <vector>
 
-/**
- * Contstructor to create a gesture recognizer
- * @param pathToModel The file path to the libsvm model
- */
-GestureRecognizer::GestureRecognizer(char* pathToModel)
-{
-	if(LoadModel(pathToModel)) // if sucessful allocate space for features
-	{
-		numberOfFrames=0;
-		svmVec = (struct svm_node *)malloc((1081)*sizeof(struct svm_node));
-		// initialize indicies and values
-		for(int i=0;i<1080;i++)
-		{
-			svmVec[i].index=i+1;
-			svmVec[i].value=0.0;
-		}
-		svmVec[1080].index=-1;
-		svmVec[1080].value=0.0;
-	}
-}
 /**
  * Constructor
  */
-GestureRecognizer::GestureRecognizer()
+GestureRecognizerBase::GestureRecognizerBase()
 {
 	svmModel=NULL;
-	numberOfFrames=0;
-	svmVec = (struct svm_node *)malloc((1081)*sizeof(struct svm_node));
-	// initialize indicies and values
-	for(int i=0;i<1080;i++)
-	{
-		svmVec[i].index=i+1;
-		svmVec[i].value=0.0;
-	}
-	svmVec[1080].index=-1;
-	svmVec[1080].value=0.0;
+	classifiable=true;
+	stride=1;
+	framesToPredict=1;
+	smoothing=SMOOTHING_NONE;
+	smoothingWindow=1;
+	hysteresis=0.0;
+	idleThreshold=0.0;
+	idleLabel=0;
+	gate=NULL;
+	decisionDag=false;
+	stats.predictions=0;
+	stats.idle=0;
+	stats.rejected=0;
+	stats.modelNs=0;
+	ClearPredictions();
 }
 
 /**
  * LoadModel
  * @param pathToModel The file path to the libsvm model
  */
-bool GestureRecognizer::LoadModel(char* pathToModel)
+bool GestureRecognizerBase::LoadModel(char* pathToModel)
 {
 	// load model
 	if((svmModel = svm_load_model(pathToModel)) == 0)
@@ -62,179 +51,503 @@ bool GestureRecognizer::LoadModel(char* pathToModel)
 		fprintf(stderr, "Can't load SVM model %s", pathToModel);
 		throw -1;
 	}
+	ClearPredictions();
 	return true;
 }
+
 /**
- * Destructor
+ * The loaded model, NULL if there is none
  */
-GestureRecognizer::~GestureRecognizer()
+const struct svm_model* GestureRecognizerBase::GetModel() const
 {
-	if(svmModel!=NULL)
-	{
-	  free(svmModel);
-	}
-	if(svmVec!=NULL)
+	return svmModel;
+}
+
+/**
+ * Only predict every few frames, the gesture is kept in between. Windows
+ * a frame apart share all but one frame so they rarely disagree.
+ * @param frames 1 to predict every frame
+ */
+void GestureRecognizerBase::SetStride(int frames)
+{
+	stride=frames<1 ? 1 : frames;
+	framesToPredict=1;
+}
+
+int GestureRecognizerBase::GetStride() const
+{
+	return stride;
+}
+
+/**
+ * Smooth the reported gesture over the recent predictions so a single
+ * stray prediction doesn't change it
+ * @param mode SMOOTHING_VOTE for the label most predictions agree on,
+ * SMOOTHING_SCORE for the best average one-vs-one margin
+ * @param window how many predictions to smooth over (stride frames apart)
+ * @param hysteresis what it takes to change the gesture once one is
+ * reported. For SMOOTHING_VOTE the fraction of the window the new label
+ * needs (it must also have more predictions than the old one), for
+ * SMOOTHING_SCORE how much higher its average margin must be.
+ */
+void GestureRecognizerBase::SetSmoothing(GestureSmoothing mode, int window, double hysteresis)
+{
+	smoothing=mode;
+	smoothingWindow=window<1 ? 1 : window;
+	this->hysteresis=hysteresis;
+	ClearPredictions();
+}
+
+/**
+ * The smoothed gesture as of the last prediction
+ * @return the class, 0 until the window is full and after a frame that was
+ * not fit to classify
+ */
+int GestureRecognizerBase::GetGesture() const
+{
+	return gesture;
+}
+
+/**
+ * Skip the model while the user's joints are still. Most of the time most
+ * users are idle, and a window that barely moves is no gesture.
+ * @param threshold motion energy (see BasicGestureRecognizer::GetMotionEnergy)
+ * below which the model is skipped, learned from the training data with
+ * MotionThreshold. 0 to always run the model.
+ * @param label what is predicted instead (e.g. NOTHING)
+ */
+void GestureRecognizerBase::SetIdleGate(double threshold, int label)
+{
+	idleThreshold=threshold;
+	idleLabel=label;
+}
+
+double GestureRecognizerBase::GetIdleThreshold() const
+{
+	return idleThreshold;
+}
+
+/**
+ * Write what MotionThreshold learned next to the model (e.g.
+ * Models/Model.idle.txt), so programs load it instead of copying the number
+ * @return false if the file can't be written
+ */
+bool GestureRecognizerBase::SaveIdleGate(const char* path, double threshold, int label)
+{
+	FILE* file=fopen(path,"w");
+	if(file==NULL)
 	{
-	  free(svmVec);
+		fprintf(stderr, "Can't write idle gate %s\n", path);
+		return false;
 	}
+	fprintf(file,"idle_threshold %.17g\nidle_label %d\n",threshold,label);
+	return fclose(file)==0;
 }
+
 /**
- * Classifies gestures
- * @return an integer which correponds to the class.
+ * Read an idle gate written by SaveIdleGate, for SetIdleGate
+ * @param label may be NULL if the caller knows its idle class
+ * @return false if the file is missing or malformed, threshold and label
+ * are left as they were
  */
-int GestureRecognizer::Classify()
+bool GestureRecognizerBase::LoadIdleGate(const char* path, double* threshold, int* label)
 {
-	// if we have 2 seconds of data
-	if(numberOfFrames==60)
+	FILE* file=fopen(path,"r");
+	if(file==NULL)
 	{
-		return (int)svm_predict(svmModel,svmVec);
+		return false;
 	}
-	else
+	double readThreshold;
+	int readLabel;
+	bool ok=fscanf(file," idle_threshold %lf idle_label %d",&readThreshold,&readLabel)==2 && readThreshold>=0.0;
+	fclose(file);
+	if(!ok)
+	{
+		fprintf(stderr, "Can't read idle gate %s\n", path);
+		return false;
+	}
+	*threshold=readThreshold;
+	if(label!=NULL)
 	{
-		return 0;
+		*label=readLabel;
 	}
+	return true;
 }
+
 /**
- * Prints the current set of features being used to classify
- * @param file an opened file pointer (append mode)
- * @param classLabel how to label this class
+ * Run a cheap model first and the full model only on the windows it lets
+ * through, a cascade. Most windows are the background class, which a
+ * linear model can turn away for the cost of one support vector.
+ * @param gate a model trained with TrainCascade, it predicts the label to
+ * report without the full model or 0 to run it. Not copied, it must
+ * outlive the recognizer, and can be shared by any number of them. NULL to
+ * always run the full model.
  */
-void GestureRecognizer::PrintFeatures(FILE *file, int classLabel)
+void GestureRecognizerBase::SetGate(const struct svm_model* gate)
 {
-	//file = fopen("log.txt", "a");
-	fprintf(file,"%d ",classLabel);
-	for(int i=0;i<1080;i++)
+	this->gate=gate;
+}
+
+const struct svm_model* GestureRecognizerBase::GetGate() const
+{
+	return gate;
+}
+
+/**
+ * Predict with a decision DAG: nr_class-1 one-vs-one decisions instead of
+ * all of them, and only the kernel values those need (see
+ * svm_predict_ddag_values). The decisions it skips count as 0 for
+ * SMOOTHING_SCORE. DdagBenchmark compares it with voting.
+ */
+void GestureRecognizerBase::SetDecisionDag(bool enabled)
+{
+	decisionDag=enabled;
+}
+
+/**
+ * How many predictions were made and how many of them skipped the model
+ */
+GesturePredictionStats GestureRecognizerBase::GetPredictionStats() const
+{
+	return stats;
+}
+
+/**
+ * True if the model can predict the label
+ */
+bool GestureRecognizerBase::HasClass(int label) const
+{
+	for(int i=0;i<svmModel->nr_class;i++)
 	{
-		fprintf(file,"%d:%lf ",i+1,svmVec[i].value);
+		if(svmModel->label[i]==label)
+		{
+			return true;
+		}
 	}
-	fprintf(file,"\n");
+	return false;
 }
+
 /**
- * Update the features used to classify gestures
- * queue of 1080 features (60 frames *18 positions)
+ * Forget the recent predictions
  */
-void GestureRecognizer::UpdateFeatures(XnVector3D torso,XnVector3D leftShoulder,XnVector3D leftElbow, XnVector3D leftHand,XnVector3D rightShoulder, XnVector3D rightElbow, XnVector3D rightHand)
+void GestureRecognizerBase::ClearPredictions()
 {
-	leftShoulder=RelativeToJoint(torso,leftShoulder);
-	leftElbow=RelativeToJoint(torso,leftElbow);
-	leftHand=RelativeToJoint(torso,leftHand);
-	rightShoulder=RelativeToJoint(torso,rightShoulder);
-	rightElbow=RelativeToJoint(torso,rightElbow);
-	rightHand=RelativeToJoint(torso,rightHand);
+	int nrClass=svmModel!=NULL ? svm_get_nr_class(svmModel) : 0;
+	gestures.clear();
+	gesture=0;
+	votes.assign(nrClass,0);
+	scores.assign(smoothingWindow*nrClass,0.0);
+	scoreSums.assign(nrClass,0.0);
+	nextScores=0;
+	decisions.resize(nrClass*(nrClass-1)/2);
+}
 
-	// if initializing queue, fill it up
-	if(numberOfFrames<60)
+/**
+ * Predict the features and update the smoothed gesture
+ * @param valid false if there is no prediction to make, the predictions
+ * start over after such a gap
+ * @param idle true to predict the idle label without the model
+ */
+void GestureRecognizerBase::Predict(const struct svm_node* features, bool valid, bool idle)
+{
+	if(!valid)
 	{
-		svmVec[numberOfFrames*18].value=leftShoulder.X;
-		svmVec[numberOfFrames*18+1].value=leftShoulder.Y;
-		svmVec[numberOfFrames*18+2].value=leftShoulder.Z;
-		svmVec[numberOfFrames*18+3].value=leftElbow.X;
-		svmVec[numberOfFrames*18+4].value=leftElbow.Y;
-		svmVec[numberOfFrames*18+5].value=leftElbow.Z;
-		svmVec[numberOfFrames*18+6].value=leftHand.X;
-		svmVec[numberOfFrames*18+7].value=leftHand.Y;
-		svmVec[numberOfFrames*18+8].value=leftHand.Z;
-
-		svmVec[numberOfFrames*18+9].value=rightShoulder.X;
-		svmVec[numberOfFrames*18+10].value=rightShoulder.Y;
-		svmVec[numberOfFrames*18+11].value=rightShoulder.Z;
-		svmVec[numberOfFrames*18+12].value=rightElbow.X;
-		svmVec[numberOfFrames*18+13].value=rightElbow.Y;
-		svmVec[numberOfFrames*18+14].value=rightElbow.Z;
-		svmVec[numberOfFrames*18+15].value=rightHand.X;
-		svmVec[numberOfFrames*18+16].value=rightHand.Y;
-		svmVec[numberOfFrames*18+17].value=rightHand.Z;
-		numberOfFrames++;
+		if(!gestures.empty() || gesture!=0)
+		{
+			ClearPredictions();
+		}
+		return;
+	}
+	int nrClass=svmModel->nr_class;
+	int label=0; // predicted without the model, only if the model can predict it too
+	stats.predictions++;
+	std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+	if(idle && HasClass(idleLabel))
+	{
+		stats.idle++;
+		label=idleLabel;
+	}
+	else if(gate!=NULL)
+	{
+		label=(int)svm_predict(gate,features);
+		if(label!=0 && HasClass(label))
+		{
+			stats.rejected++;
+		}
+		else
+		{
+			label=0;
+		}
+	}
+	if(label!=0)
+	{
+		// as if the label won every contest by the margin
+		int p=0;
+		for(int i=0;i<nrClass;i++)
+		{
+			for(int j=i+1;j<nrClass;j++)
+			{
+				decisions[p++]=svmModel->label[i]==label ? 1.0 : (svmModel->label[j]==label ? -1.0 : 0.0);
+			}
+		}
+	}
+	else if(decisionDag)
+	{
+		label=(int)svm_predict_ddag_values(svmModel,features,&decisions[0]);
+	}
+	else if(smoothing==SMOOTHING_SCORE)
+	{
+		label=(int)svm_predict_values(svmModel,features,&decisions[0]);
 	}
-	// otherwise, shift data and insert new frame to the end
 	else
 	{
-		ShiftDataDown();
-		// put data into last frame
-		svmVec[1062].value=leftShoulder.X;
-		svmVec[1063].value=leftShoulder.Y;
-		svmVec[1064].value=leftShoulder.Z;
-		svmVec[1065].value=leftElbow.X;
-		svmVec[1066].value=leftElbow.Y;
-		svmVec[1067].value=leftElbow.Z;
-		svmVec[1068].value=leftHand.X;
-		svmVec[1069].value=leftHand.Y;
-		svmVec[1070].value=leftHand.Z;
-
-		svmVec[1071].value=rightShoulder.X;
-		svmVec[1072].value=rightShoulder.Y;
-		svmVec[1073].value=rightShoulder.Z;
-		svmVec[1074].value=rightElbow.X;
-		svmVec[1075].value=rightElbow.Y;
-		svmVec[1076].value=rightElbow.Z;
-		svmVec[1077].value=rightHand.X;
-		svmVec[1078].value=rightHand.Y;
-		svmVec[1079].value=rightHand.Z;
-		if(gestures.size()>0)
+		label=(int)svm_predict(svmModel,features);
+	}
+	stats.modelNs+=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+	if(smoothing==SMOOTHING_NONE)
+	{
+		gestures.assign(1,label);
+		gesture=label;
+		return;
+	}
+
+	int predicted=0;
+	while(svmModel->label[predicted]!=label)
+	{
+		predicted++;
+	}
+	int current=-1;
+	for(int i=0;i<nrClass;i++)
+	{
+		if(svmModel->label[i]==gesture)
 		{
-			gestures.pop_front();
+			current=i;
 		}
 	}
-	if(svmModel!=NULL)
+	if((int)gestures.size()==smoothingWindow)
 	{
-	  gestures.push_back(Classify());
+		int oldest=0;
+		while(svmModel->label[oldest]!=gestures.front())
+		{
+			oldest++;
+		}
+		votes[oldest]--;
+		gestures.pop_front();
+	}
+	gestures.push_back(label);
+	votes[predicted]++;
+
+	int best=predicted;
+	if(smoothing==SMOOTHING_VOTE)
+	{
+		for(int i=0;i<nrClass;i++)
+		{
+			if(votes[i]>votes[best])
+			{
+				best=i;
+			}
+		}
+		int currentVotes=current<0 ? 0 : votes[current];
+		if(votes[best]>currentVotes && votes[best]>=hysteresis*gestures.size())
+		{
+			gesture=svmModel->label[best];
+		}
+		return;
+	}
+
+	// a class's margin is its average one-vs-one decision value
+	double* margins=&scores[nextScores*nrClass];
+	for(int i=0;i<nrClass;i++)
+	{
+		scoreSums[i]-=margins[i];
+		margins[i]=0.0;
+	}
+	int p=0;
+	for(int i=0;i<nrClass;i++)
+	{
+		for(int j=i+1;j<nrClass;j++,p++)
+		{
+			margins[i]+=decisions[p];
+			margins[j]-=decisions[p];
+		}
+	}
+	for(int i=0;i<nrClass;i++)
+	{
+		margins[i]/=nrClass>1 ? nrClass-1 : 1;
+		scoreSums[i]+=margins[i];
+		if(scoreSums[i]>scoreSums[best])
+		{
+			best=i;
+		}
+	}
+	nextScores=(nextScores+1)%smoothingWindow;
+	if(current<0 || (scoreSums[best]-scoreSums[current])/gestures.size()>=hysteresis)
+	{
+		gesture=svmModel->label[best];
 	}
 }
 /**
- * RelativeToJoint
- * Normalize the joint positions to a central joint
+ * Destructor
  */
-XnVector3D GestureRecognizer::RelativeToJoint(XnVector3D main, XnVector3D other)
+GestureRecognizerBase::~GestureRecognizerBase()
 {
-	//TODO take this off the stack
-	XnVector3D normalized;
-	normalized.X = other.X-main.X;
-	normalized.Y = other.Y-main.Y;
-	normalized.Z = other.Z-main.Z;
-	return normalized;
+	if(svmModel!=NULL)
+	{
+	  free(svmModel);
+	}
 }
 /**
- * ShiftDataDown
- * Shifts data down by segments of 18 (1 frame)
+ * Prints one sample in LIBSVM format
+ * @param file an opened file pointer (append mode)
+ * @param classLabel how to label this class
+ * @param numFeatures how many features there are, sizes the line buffer
  */
-void GestureRecognizer::ShiftDataDown()
+void GestureRecognizerBase::PrintFeatures(FILE *file, int classLabel, const struct svm_node* features, int numFeatures)
 {
-	for(int i=17;i<1080;i++)
+	std::vector<char> line(numFeatures*24);
+	char* end;
+	while((end=FormatFeatures(&line[0],&line[0]+line.size(),classLabel,features))==NULL)
 	{
-		svmVec[i-17].value=svmVec[i].value;
+		line.resize(line.size()*2);
 	}
+	fwrite(&line[0],1,end-&line[0],file);
 }
 
+/**
+ * Formats one sample as a LIBSVM line ("label 1:value 2:value ...\n",
+ * values with 6 decimals like %lf) using std::to_chars
+ * @param features terminated by a node with index -1
+ * @return the end of the formatted text, NULL if it did not fit
+ */
+char* GestureRecognizerBase::FormatFeatures(char* out, char* end, int classLabel, const struct svm_node* features)
+{
+	std::to_chars_result result = std::to_chars(out,end,classLabel);
+	if(result.ec!=std::errc() || result.ptr==end)
+	{
+		return NULL;
+	}
+	out=result.ptr;
+	*out++=' ';
+	for(int i=0;features[i].index!=-1;i++)
+	{
+		result = std::to_chars(out,end,features[i].index);
+		if(result.ec!=std::errc() || result.ptr==end)
+		{
+			return NULL;
+		}
+		out=result.ptr;
+		*out++=':';
+		result = std::to_chars(out,end,features[i].value,std::chars_format::fixed,6);
+		if(result.ec!=std::errc() || result.ptr==end)
+		{
+			return NULL;
+		}
+		out=result.ptr;
+		*out++=' ';
+	}
+	if(out==end)
+	{
+		return NULL;
+	}
+	*out++='\n';
+	return out;
+}
 /**
  * Assignment operator
  */
-GestureRecognizer GestureRecognizer::operator=(const GestureRecognizer & other)
+GestureRecognizerBase& GestureRecognizerBase::operator=(const GestureRecognizerBase & other)
 {
-	this->numberOfFrames=other.numberOfFrames;
-	if(this->svmVec!=NULL)
+	if(this==&other)
 	{
-		free(svmVec);
+		return *this;
+	}
+	this->classifiable=other.classifiable;
+	this->gestures=other.gestures;
+	CopyPredictions(other);
+	if(other.svmModel==NULL)
+	{
+		if(this->svmModel!=NULL)
+		{
+			free(svmModel);
+		}
+		svmModel=NULL;
+	}
+	else
+	{
+		if(this->svmModel==NULL)
+		{
+			svmModel = (svm_model*)malloc(sizeof(struct svm_model));
+		}
+		memcpy(this->svmModel, other.svmModel, sizeof(svm_model));
+	}
+	return *this;
+}
+/**
+ * Move assignment operator
+ * Takes ownership of the model without copying it
+ */
+GestureRecognizerBase& GestureRecognizerBase::operator=(GestureRecognizerBase && other)
+{
+	if(this==&other)
+	{
+		return *this;
 	}
 	if(this->svmModel!=NULL)
 	{
 		free(svmModel);
 	}
-	svmVec = (struct svm_node *)malloc((1081)*sizeof(struct svm_node));
-	memcpy(this->svmVec,other.svmVec,1081*sizeof(svm_node));
-	svmModel = (svm_model*)malloc(sizeof(struct svm_model));
-	memcpy(this->svmModel, other.svmModel, sizeof(svm_model));
+	this->classifiable=other.classifiable;
+	this->gestures.swap(other.gestures);
+	CopyPredictions(other);
+	svmModel=other.svmModel;
+	other.svmModel=NULL;
 	return *this;
-
 }
 /**
  * Copy Constructor
  */
-GestureRecognizer::GestureRecognizer(const GestureRecognizer& other)
+GestureRecognizerBase::GestureRecognizerBase(const GestureRecognizerBase& other)
+{
+	this->classifiable=other.classifiable;
+	this->gestures=other.gestures;
+	CopyPredictions(other);
+	svmModel=NULL;
+	if(other.svmModel!=NULL)
+	{
+		svmModel = (svm_model*)malloc(sizeof(struct svm_model));
+		memcpy(this->svmModel, other.svmModel, sizeof(svm_model));
+	}
+}
+/**
+ * Move Constructor
+ */
+GestureRecognizerBase::GestureRecognizerBase(GestureRecognizerBase&& other)
 {
-	this->numberOfFrames=other.numberOfFrames;
-	svmVec = (struct svm_node *)malloc((1081)*sizeof(struct svm_node));
-	memcpy(this->svmVec,other.svmVec,1081*sizeof(svm_node));
-	svmModel = (svm_model*)malloc(sizeof(struct svm_model));
-	memcpy(this->svmModel, other.svmModel, sizeof(svm_model));
+	this->classifiable=other.classifiable;
+	this->gestures.swap(other.gestures);
+	CopyPredictions(other);
+	svmModel=other.svmModel;
+	other.svmModel=NULL;
+}
+/**
+ * Copy the stride, smoothing and recent predictions of another recognizer
+ */
+void GestureRecognizerBase::CopyPredictions(const GestureRecognizerBase& other)
+{
+	stride=other.stride;
+	framesToPredict=other.framesToPredict;
+	smoothing=other.smoothing;
+	smoothingWindow=other.smoothingWindow;
+	hysteresis=other.hysteresis;
+	gesture=other.gesture;
+	votes=other.votes;
+	scores=other.scores;
+	scoreSums=other.scoreSums;
+	nextScores=other.nextScores;
+	decisions=other.decisions;
+	idleThreshold=other.idleThreshold;
+	idleLabel=other.idleLabel;
+	gate=other.gate;
+	decisionDag=other.decisionDag;
+	stats=other.stats;
 }
-
@@ -7,60 +7,528 @@
 #ifndef GESTURE_RECOGNIZER_H
 #define GESTURE_RECOGNIZER_H
 #include "svm.h"
+#include "SkeletonFrame.h"
 #include <XnOpenNI.h>
 #include <XnCodecIDs.h>
 #include <XnCppWrapper.h>
 /*************************************************
  * GestureRecognizer.h
- * 
+ *
  * Used to classify gestures in real-time using OpenNI and LIBSVM
- * 
- * Uses an array of 1080 features which are updated with each new frame of 
- * data from the Kinect.
- * 
+ *
+ * Keeps a window of the last Frames frames of features which is updated
+ * with each new frame of data from the Kinect. A frame of features is the
+ * X,Y,Z of every joint in a JointList, relative to the torso.
+ *
+ * The joint list and window length are template parameters, so the feature
+ * layout, buffer sizes and copy loops are all fixed at compile time. The
+ * default GestureRecognizer is both arms (6 joints) over 60 frames, 1080
+ * features. A model only works with the recognizer type whose features it
+ * was trained on; LogToFeatures -w/-j produce training data for other types.
+ *
+ * GestureRecognizer has always moved its window down 17 features a frame,
+ * not 18, and Models/Model.txt and the samples in Data/ were recorded that
+ * way. Each older frame keeps its first 17 features (the newest frame's
+ * first feature overwrites the last), so the 1080 features reach about 63
+ * frames back. The Shift parameter keeps that layout for GestureRecognizer;
+ * other recognizers move whole frames.
+ *
  * Author: Aaron Pulver <atp1317@rit.edu>
  * **************************************************************************/
 
 #include <XnPropNames.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <deque>
+#include <vector>
 
-
-class GestureRecognizer
+/**
+ * The SkeletonJoints that make up one frame of features, in feature order
+ */
+template<int... Joints>
+struct JointList
 {
-private:
-	struct svm_node *svmVec; // The array of features
-	struct svm_model *svmModel; // The model which is loaded
-	int numberOfFrames; // number of frames 
-	std::deque<int> gestures;
+	static const int COUNT = sizeof...(Joints);
+	static const XnUInt32 MASK = ((1u<<SKELETON_TORSO) | ... | (1u<<Joints)); // joints the features depend on
 
-	void ShiftDataDown();
-	XnVector3D RelativeToJoint(XnVector3D main, XnVector3D other);
-
-public:
-	int Classify();
-	void PrintFeatures(FILE* file, int classLabel);
-	void UpdateFeatures(XnVector3D torso,XnVector3D leftShoulder,XnVector3D leftElbow, XnVector3D leftHand,XnVector3D rightShoulder, XnVector3D rightElbow, XnVector3D rightHand);
-	GestureRecognizer(char* pathToModel);
-	GestureRecognizer();
-	bool LoadModel(char* path);
-	GestureRecognizer operator=(const GestureRecognizer & rhs);
-	GestureRecognizer(const GestureRecognizer& other);
-	~GestureRecognizer();
+	/**
+	 * Copies X,Y,Z of each joint, unrolled by the compiler
+	 */
+	static void Copy(const UserSkeleton& relative, struct svm_node* node)
+	{
+		int i = 0;
+		((node[i].value=relative.x[Joints], node[i+1].value=relative.y[Joints], node[i+2].value=relative.z[Joints], i+=3), ...);
+	}
+	/**
+	 * The reverse of Copy, sets each joint from X,Y,Z values
+	 */
+	static void Set(const double* values, UserSkeleton& skeleton)
+	{
+		int i = 0;
+		((skeleton.x[Joints]=(float)values[i], skeleton.y[Joints]=(float)values[i+1], skeleton.z[Joints]=(float)values[i+2], i+=3), ...);
+	}
 };
 
+typedef JointList<SKELETON_LEFT_SHOULDER,SKELETON_LEFT_ELBOW,SKELETON_LEFT_HAND,
+		SKELETON_RIGHT_SHOULDER,SKELETON_RIGHT_ELBOW,SKELETON_RIGHT_HAND> ArmJoints;
+// every logged joint but the torso, in the order LogToFeatures -j lists them
+typedef JointList<SKELETON_HEAD,SKELETON_NECK,
+		SKELETON_LEFT_SHOULDER,SKELETON_LEFT_ELBOW,SKELETON_LEFT_HAND,
+		SKELETON_RIGHT_SHOULDER,SKELETON_RIGHT_ELBOW,SKELETON_RIGHT_HAND,
+		SKELETON_LEFT_HIP,SKELETON_LEFT_KNEE,SKELETON_LEFT_FOOT,
+		SKELETON_RIGHT_HIP,SKELETON_RIGHT_KNEE,SKELETON_RIGHT_FOOT> FullBodyJoints;
 
+/**
+ * How the recent predictions are turned into the reported gesture
+ */
+enum GestureSmoothing
+{
+	SMOOTHING_NONE, // the latest prediction
+	SMOOTHING_VOTE, // the label most of the recent predictions agree on
+	SMOOTHING_SCORE // the label with the best average one-vs-one margin
+};
 
+struct GesturePredictionStats
+{
+	XnUInt64 predictions; // predictions made, with or without the model
+	XnUInt64 idle; // predictions of the idle label without running the model
+	XnUInt64 rejected; // predictions the gate rejected without running the model
+	XnUInt64 modelNs; // time spent running the gate and the model
+};
 
+/**
+ * The parts of a recognizer that don't depend on its feature layout: the
+ * model, the recent predictions and LIBSVM formatting
+ */
+class GestureRecognizerBase
+{
+protected:
+	struct svm_model *svmModel; // The model which is loaded
+	std::deque<int> gestures; // the recent predictions, oldest first
+	bool classifiable; // false if the newest frame should not be classified
 
+	int stride; // frames between predictions
+	int framesToPredict; // frames until the next prediction
+	GestureSmoothing smoothing;
+	int smoothingWindow; // predictions the reported gesture is smoothed over
+	double hysteresis;
+	int gesture; // the reported gesture
+	std::vector<int> votes; // recent predictions of each class
+	std::vector<double> scores; // one-vs-one margins of each class for each recent prediction
+	std::vector<double> scoreSums; // of each class over the recent predictions
+	int nextScores; // where the next prediction's margins go in scores
+	std::vector<double> decisions;
+	double idleThreshold; // motion energy below which the model is skipped, 0 to always run it
+	int idleLabel; // what an idle user is doing
+	const struct svm_model* gate; // the cascade's first stage, not owned
+	bool decisionDag; // predict with svm_predict_ddag_values instead of voting
+	GesturePredictionStats stats;
 
+	GestureRecognizerBase();
+	GestureRecognizerBase(const GestureRecognizerBase& other);
+	GestureRecognizerBase(GestureRecognizerBase&& other);
+	GestureRecognizerBase& operator=(const GestureRecognizerBase& other);
+	GestureRecognizerBase& operator=(GestureRecognizerBase&& other);
+	~GestureRecognizerBase();
+	static void PrintFeatures(FILE* file, int classLabel, const struct svm_node* features, int numFeatures);
+	void Predict(const struct svm_node* features, bool valid, bool idle);
+	void ClearPredictions();
+	void CopyPredictions(const GestureRecognizerBase& other);
+	bool HasClass(int label) const;
 
+public:
+	bool LoadModel(char* path);
+	const struct svm_model* GetModel() const;
+	void SetStride(int frames);
+	int GetStride() const;
+	void SetSmoothing(GestureSmoothing mode, int window, double hysteresis);
+	int GetGesture() const;
+	void SetIdleGate(double threshold, int label);
+	double GetIdleThreshold() const;
+	static bool SaveIdleGate(const char* path, double threshold, int label);
+	static bool LoadIdleGate(const char* path, double* threshold, int* label);
+	void SetGate(const struct svm_model* gate);
+	void SetDecisionDag(bool enabled);
+	const struct svm_model* GetGate() const;
+	GesturePredictionStats GetPredictionStats() const;
+	static char* FormatFeatures(char* out, char* end, int classLabel, const struct svm_node* features);
+};
 
+/**
+ * @param Shift features the window moves down each frame, a frame's worth
+ * unless a model expects otherwise
+ */
+template<class Joints, int Frames, int Shift = Joints::COUNT*3>
+class BasicGestureRecognizer : public GestureRecognizerBase
+{
+public:
+	static const int FRAMES = Frames;
+	static const int FRAME_FEATURES = Joints::COUNT*3;
+	static const int FEATURES = FRAME_FEATURES*FRAMES;
+	static const int SHIFT = Shift;
+	static const int WINDOW_FRAMES = (FEATURES-FRAME_FEATURES+SHIFT-1)/SHIFT+1; // frames with features in the window, the oldest maybe only partly
+	static const int MOTION_FEATURES = SHIFT<FRAME_FEATURES ? SHIFT : FRAME_FEATURES; // features every frame keeps
+	static const XnUInt32 JOINT_MASK = Joints::MASK;
+	typedef Joints FrameJoints;
 
+private:
+	struct svm_node *svmVec; // The array of features
+	int numberOfFrames; // number of frames
+	/**
+	 * Squared motion of each of the last FRAMES frames and their sum, the
+	 * window's motion energy
+	 */
+	double frameMotion[Frames];
+	int motionIndex;
+	double motionSum;
 
+	/**
+	 * Allocate the window, indices 1 to FEATURES and a terminating node
+	 */
+	void AllocateFeatures()
+	{
+		svmVec = (struct svm_node *)malloc((FEATURES+1)*sizeof(struct svm_node));
+		for(int i=0;i<FEATURES;i++)
+		{
+			svmVec[i].index=i+1;
+			svmVec[i].value=0.0;
+		}
+		svmVec[FEATURES].index=-1;
+		svmVec[FEATURES].value=0.0;
+	}
+	/**
+	 * Forget the motion of every frame
+	 */
+	void ClearMotion()
+	{
+		for(int i=0;i<FRAMES;i++)
+		{
+			frameMotion[i]=0.0;
+		}
+		motionIndex=0;
+		motionSum=0.0;
+	}
+	void CopyMotion(const BasicGestureRecognizer& other)
+	{
+		memcpy(frameMotion,other.frameMotion,sizeof(frameMotion));
+		motionIndex=other.motionIndex;
+		motionSum=other.motionSum;
+	}
+	/**
+	 * Add the newest frame's motion to the window's, O(MOTION_FEATURES).
+	 * The previous frame's first MOTION_FEATURES features are still in the
+	 * window right before the newest frame.
+	 */
+	void UpdateMotion()
+	{
+		double motion=0.0;
+		if(numberOfFrames>1)
+		{
+			const struct svm_node* newest=&svmVec[FrameOffset(0)];
+			const struct svm_node* previous=&svmVec[FrameOffset(1)];
+			for(int i=0;i<MOTION_FEATURES;i++)
+			{
+				double delta=newest[i].value-previous[i].value;
+				motion+=delta*delta;
+			}
+		}
+		motionSum+=motion-frameMotion[motionIndex];
+		frameMotion[motionIndex]=motion;
+		if(++motionIndex==FRAMES)
+		{
+			// sum again now and then so rounding errors don't build up
+			motionIndex=0;
+			motionSum=0.0;
+			for(int i=0;i<FRAMES;i++)
+			{
+				motionSum+=frameMotion[i];
+			}
+		}
+	}
+	/**
+	 * Shifts data down by one frame (SHIFT features)
+	 */
+	void ShiftDataDown()
+	{
+		for(int i=SHIFT;i<FEATURES;i++)
+		{
+			svmVec[i-SHIFT].value=svmVec[i].value;
+		}
+	}
 
+public:
+	/**
+	 * Contstructor to create a gesture recognizer
+	 * @param pathToModel The file path to the libsvm model
+	 */
+	BasicGestureRecognizer(char* pathToModel)
+	{
+		numberOfFrames=0;
+		ClearMotion();
+		AllocateFeatures();
+		LoadModel(pathToModel);
+	}
+	/**
+	 * Constructor
+	 */
+	BasicGestureRecognizer()
+	{
+		numberOfFrames=0;
+		ClearMotion();
+		AllocateFeatures();
+	}
+	/**
+	 * Copy Constructor
+	 */
+	BasicGestureRecognizer(const BasicGestureRecognizer& other)
+		: GestureRecognizerBase(other)
+	{
+		this->numberOfFrames=other.numberOfFrames;
+		CopyMotion(other);
+		svmVec = (struct svm_node *)malloc((FEATURES+1)*sizeof(struct svm_node));
+		memcpy(this->svmVec,other.svmVec,(FEATURES+1)*sizeof(svm_node));
+	}
+	/**
+	 * Move Constructor
+	 */
+	BasicGestureRecognizer(BasicGestureRecognizer&& other)
+		: GestureRecognizerBase(std::move(other))
+	{
+		this->numberOfFrames=other.numberOfFrames;
+		CopyMotion(other);
+		svmVec=other.svmVec;
+		other.svmVec=NULL;
+		other.numberOfFrames=0;
+	}
+	/**
+	 * Assignment operator
+	 */
+	BasicGestureRecognizer& operator=(const BasicGestureRecognizer& other)
+	{
+		if(this==&other)
+		{
+			return *this;
+		}
+		GestureRecognizerBase::operator=(other);
+		this->numberOfFrames=other.numberOfFrames;
+		CopyMotion(other);
+		// the feature window is always the same size so it can be reused in place
+		if(this->svmVec==NULL)
+		{
+			svmVec = (struct svm_node *)malloc((FEATURES+1)*sizeof(struct svm_node));
+		}
+		memcpy(this->svmVec,other.svmVec,(FEATURES+1)*sizeof(svm_node));
+		return *this;
+	}
+	/**
+	 * Move assignment operator
+	 * Takes ownership of the feature window and model without copying them
+	 */
+	BasicGestureRecognizer& operator=(BasicGestureRecognizer&& other)
+	{
+		if(this==&other)
+		{
+			return *this;
+		}
+		GestureRecognizerBase::operator=(std::move(other));
+		if(this->svmVec!=NULL)
+		{
+			free(svmVec);
+		}
+		this->numberOfFrames=other.numberOfFrames;
+		CopyMotion(other);
+		svmVec=other.svmVec;
+		other.svmVec=NULL;
+		other.numberOfFrames=0;
+		return *this;
+	}
+	/**
+	 * Destructor
+	 */
+	~BasicGestureRecognizer()
+	{
+		if(svmVec!=NULL)
+		{
+			free(svmVec);
+		}
+	}
 
+	/**
+	 * Classifies gestures now, whatever the stride. GetGesture is the
+	 * smoothed gesture UpdateFeatures already predicted.
+	 * @return an integer which correponds to the class, 0 without a full
+	 * window of data or when the newest frame was not fit to classify
+	 */
+	int Classify()
+	{
+		if(numberOfFrames==FRAMES && classifiable)
+		{
+			return (int)svm_predict(svmModel,svmVec);
+		}
+		else
+		{
+			return 0;
+		}
+	}
+	/**
+	 * Prints the current set of features being used to classify
+	 * @param file an opened file pointer (append mode)
+	 * @param classLabel how to label this class
+	 */
+	void PrintFeatures(FILE* file, int classLabel)
+	{
+		GestureRecognizerBase::PrintFeatures(file,classLabel,svmVec,FEATURES);
+	}
+	/**
+	 * The current features, terminated by a node with index -1
+	 */
+	const struct svm_node* GetFeatures() const
+	{
+		return svmVec;
+	}
+	/**
+	 * How many frames the window holds, at most FRAMES. The newest frame is
+	 * always at the end of the window, features before the oldest are 0.
+	 */
+	int GetNumberOfFrames() const
+	{
+		return numberOfFrames;
+	}
+	/**
+	 * Where a frame starts in the features
+	 * @param framesBack 0 for the newest frame, 1 for the one before...
+	 */
+	static int FrameOffset(int framesBack)
+	{
+		return FEATURES-FRAME_FEATURES-framesBack*SHIFT;
+	}
+	/**
+	 * How many of a frame's features are still in the window, older frames
+	 * lose the ones the next frame overwrote
+	 */
+	static int FrameLength(int framesBack)
+	{
+		return framesBack==0 || SHIFT>FRAME_FEATURES ? FRAME_FEATURES : SHIFT;
+	}
+	/**
+	 * Turn a frame of a window back into a skeleton (relative to the torso,
+	 * which is left at 0). Features the frame lost to newer frames are 0.
+	 * @param window FEATURES values, e.g. a sample read back from a file
+	 * @param framesBack 0 for the newest frame, up to WINDOW_FRAMES-1
+	 */
+	static void WindowFrame(const double* window, int framesBack, UserSkeleton& relative)
+	{
+		double values[FRAME_FEATURES] = {0};
+		int offset=FrameOffset(framesBack);
+		for(int i=offset<0 ? -offset : 0;i<FrameLength(framesBack);i++)
+		{
+			values[i]=window[offset+i];
+		}
+		memset(&relative,0,sizeof(relative));
+		relative.validJoints=JOINT_MASK;
+		Joints::Set(values,relative);
+	}
+	/**
+	 * How much the joints moved over the window: the root mean square
+	 * distance a joint moved (relative to the torso) from one frame to the
+	 * next, in mm per frame. Only the features every frame keeps in the
+	 * window count, so a stored sample replayed frame by frame ends with the
+	 * same energy as it was recorded with.
+	 */
+	double GetMotionEnergy() const
+	{
+		return sqrt((motionSum>0.0 ? motionSum : 0.0)/(FRAMES*Joints::COUNT));
+	}
+	/**
+	 * The motion energy of only the newest few frames of the window (see
+	 * GetMotionEnergy), quick to follow a gesture starting and stopping.
+	 * MotionSegmenter is driven by it.
+	 * @param frames how many of the newest frames, 1 to FRAMES
+	 */
+	double GetRecentMotionEnergy(int frames) const
+	{
+		frames=frames<1 ? 1 : (frames>FRAMES ? FRAMES : frames);
+		double sum=0.0;
+		int index=motionIndex;
+		for(int i=0;i<frames;i++)
+		{
+			index=index==0 ? FRAMES-1 : index-1;
+			sum+=frameMotion[index];
+		}
+		return sqrt(sum/(frames*Joints::COUNT));
+	}
+	/**
+	 * True if the joints are too still over the window for a gesture, the
+	 * model is not run and the idle label is predicted (see SetIdleGate)
+	 */
+	bool IsIdle() const
+	{
+		return idleThreshold>0.0 && numberOfFrames==FRAMES && GetMotionEnergy()<idleThreshold;
+	}
+	/**
+	 * False if the newest frame was not fit to classify
+	 */
+	bool IsClassifiable() const
+	{
+		return classifiable;
+	}
+	/**
+	 * Update the features used to classify gestures
+	 * @param skeleton the user's joints, normalized to the torso here
+	 * @param classify false to only advance the window, for a frame whose
+	 * joints are too unreliable to be worth a prediction
+	 * @param predict false to put off a prediction that is due to a later
+	 * frame, keeping the gesture. For users that only get a share of the
+	 * predictions.
+	 */
+	void UpdateFeatures(const UserSkeleton& skeleton, bool classify = true, bool predict = true)
+	{
+		classifiable=classify;
+		UserSkeleton relative;
+		RelativeToTorso(skeleton,relative);
 
+		// shift data and insert new frame to the end, even while the window
+		// is filling so the newest frames are always at the end
+		ShiftDataDown();
+		if(numberOfFrames<FRAMES)
+		{
+			numberOfFrames++;
+		}
+		Joints::Copy(relative,&svmVec[FEATURES-FRAME_FEATURES]);
+		UpdateMotion();
+		if(framesToPredict>0)
+		{
+			framesToPredict--;
+		}
+		if(svmModel!=NULL && framesToPredict==0 && predict)
+		{
+			framesToPredict=stride;
+			Predict(svmVec,numberOfFrames==FRAMES && classifiable,IsIdle());
+		}
+	}
+	/**
+	 * Update the features from separate joint positions of the torso and
+	 * arms (see UpdateFeatures(const UserSkeleton&, bool))
+	 */
+	void UpdateFeatures(XnVector3D torso,XnVector3D leftShoulder,XnVector3D leftElbow, XnVector3D leftHand,XnVector3D rightShoulder, XnVector3D rightElbow, XnVector3D rightHand, bool classify = true)
+	{
+		UserSkeleton skeleton;
+		memset(&skeleton,0,sizeof(skeleton));
+		skeleton.SetJoint(SKELETON_TORSO,torso);
+		skeleton.SetJoint(SKELETON_LEFT_SHOULDER,leftShoulder);
+		skeleton.SetJoint(SKELETON_LEFT_ELBOW,leftElbow);
+		skeleton.SetJoint(SKELETON_LEFT_HAND,leftHand);
+		skeleton.SetJoint(SKELETON_RIGHT_SHOULDER,rightShoulder);
+		skeleton.SetJoint(SKELETON_RIGHT_ELBOW,rightElbow);
+		skeleton.SetJoint(SKELETON_RIGHT_HAND,rightHand);
+		UpdateFeatures(skeleton,classify);
+	}
+};
 
+typedef BasicGestureRecognizer<ArmJoints,60,17> GestureRecognizer; // the layout of Models/Model.txt
+typedef BasicGestureRecognizer<ArmJoints,30> ShortGestureRecognizer; // 1 second window
+typedef BasicGestureRecognizer<FullBodyJoints,60> FullBodyGestureRecognizer;
 
 #endif
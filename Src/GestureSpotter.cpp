@@ -0,0 +1,349 @@
+/******************************************************************************
+ * GestureSpotter.cpp
+ *
+ * Classifies windows of several lengths from one history of frames.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "GestureSpotter.h"
+#include <math.h>
+#include <algorithm>
+
+/**
+ * base^times, the same way LIBSVM computes the polynomial kernel
+ */
+static double Powi(double base, int times)
+{
+	double tmp = base, ret = 1.0;
+	for(int t=times;t>0;t/=2)
+	{
+		if(t%2==1)
+		{
+			ret *= tmp;
+		}
+		tmp = tmp*tmp;
+	}
+	return ret;
+}
+
+/**
+ * Constructor, add scales before the first frame
+ * @param pathToModel The file path to a LIBSVM classification model trained
+ * on GestureRecognizer features. Throws -1 like GestureRecognizer::LoadModel
+ * if it can't be loaded or isn't a classification model with at most
+ * SPOTTER_MAX_CLASSES classes.
+ */
+GestureSpotter::GestureSpotter(char* pathToModel)
+{
+	model = svm_load_model(pathToModel);
+	if(model==NULL)
+	{
+		fprintf(stderr, "Can't load SVM model %s", pathToModel);
+		throw -1;
+	}
+	int type = svm_get_svm_type(model);
+	if((type!=C_SVC && type!=NU_SVC) || model->param.kernel_type==PRECOMPUTED || model->nr_class>SPOTTER_MAX_CLASSES)
+	{
+		fprintf(stderr, "Can't spot gestures with SVM model %s", pathToModel);
+		svm_free_and_destroy_model(&model);
+		throw -1;
+	}
+	numSV = model->l;
+	supportVectors.assign((size_t)numSV*GestureRecognizer::FEATURES,0.0);
+	supportNorms.assign(numSV,0.0);
+	for(int i=0;i<numSV;i++)
+	{
+		for(const struct svm_node* node=model->SV[i];node->index!=-1;node++)
+		{
+			if(node->index>=1 && node->index<=GestureRecognizer::FEATURES)
+			{
+				supportVectors[(size_t)i*GestureRecognizer::FEATURES+node->index-1] = node->value;
+				supportNorms[i] += node->value*node->value;
+			}
+		}
+	}
+	kernel.resize(numSV);
+	numScales = 0;
+	historyLength = 1;
+	Reset();
+}
+
+/**
+ * Destructor
+ */
+GestureSpotter::~GestureSpotter()
+{
+	svm_free_and_destroy_model(&model);
+}
+
+/**
+ * Add a window length to classify, clears the history
+ * @param frames how many frames the gesture takes at this scale, FRAMES
+ * for the recognizer's own window
+ * @return false if there is no room for another scale or frames is not
+ * between 1 and 4*FRAMES
+ */
+bool GestureSpotter::AddScale(int frames)
+{
+	if(numScales==SPOTTER_MAX_SCALES || frames<1 || frames>4*GestureRecognizer::FRAMES)
+	{
+		return false;
+	}
+	int i = numScales;
+	while(i>0 && scales[i-1]>frames)
+	{
+		scales[i] = scales[i-1];
+		std::copy(ages[i-1],ages[i-1]+SLOTS,ages[i]);
+		i--;
+	}
+	scales[i] = frames;
+	for(int k=0;k<SLOTS;k++)
+	{
+		// nearest frame, rounding halves up
+		ages[i][k] = (2*k*frames+GestureRecognizer::FRAMES)/(2*GestureRecognizer::FRAMES);
+	}
+	historyLength = std::max(historyLength,ages[i][SLOTS-1]+1);
+	numScales++;
+	Reset();
+	return true;
+}
+
+int GestureSpotter::GetNumScales() const
+{
+	return numScales;
+}
+
+/**
+ * Frames of a scale, scales are numbered shortest first
+ */
+int GestureSpotter::GetScaleFrames(int scale) const
+{
+	return scales[scale];
+}
+
+/**
+ * Forget every frame, use when the spotter is handed to a new user
+ */
+void GestureSpotter::Reset()
+{
+	frames.assign((size_t)historyLength*GestureRecognizer::FRAME_FEATURES,0.0);
+	dots.assign((size_t)historyLength*SLOTS*numSV,0.0);
+	norms.assign((size_t)historyLength*SLOTS,0.0);
+	newest = 0;
+	numberOfFrames = 0;
+	classifiable = false;
+}
+
+/**
+ * Add the newest frame to the history and take its dot products with every
+ * slot of every support vector
+ * @param skeleton the user's joints, normalized to the torso here
+ * @param classify false if the frame is too unreliable to be worth a
+ * prediction (see GestureRecognizer::UpdateFeatures)
+ */
+void GestureSpotter::UpdateFeatures(const UserSkeleton& skeleton, bool classify)
+{
+	const int frameFeatures = GestureRecognizer::FRAME_FEATURES;
+	const int features = GestureRecognizer::FEATURES;
+	classifiable = classify;
+	UserSkeleton relative;
+	RelativeToTorso(skeleton,relative);
+	struct svm_node frame[frameFeatures];
+	GestureRecognizer::FrameJoints::Copy(relative,frame);
+
+	newest = (newest+1)%historyLength;
+	if(numberOfFrames<historyLength)
+	{
+		numberOfFrames++;
+	}
+	double* values = &frames[(size_t)newest*frameFeatures];
+	for(int j=0;j<frameFeatures;j++)
+	{
+		values[j] = frame[j].value;
+	}
+	for(int k=0;k<SLOTS;k++)
+	{
+		// the part of the frame that would be in slot k of the window
+		int offset = GestureRecognizer::FrameOffset(k);
+		int first = offset<0 ? -offset : 0;
+		int length = GestureRecognizer::FrameLength(k);
+		double norm = 0.0;
+		for(int j=first;j<length;j++)
+		{
+			norm += values[j]*values[j];
+		}
+		norms[(size_t)newest*SLOTS+k] = norm;
+		double* slotDots = &dots[((size_t)newest*SLOTS+k)*numSV];
+		// the oldest slot starts before the window, skip to its first feature
+		const double* sv = supportVectors.data()+offset+first;
+		for(int i=0;i<numSV;i++,sv+=features)
+		{
+			double dot = 0.0;
+			for(int j=first;j<length;j++)
+			{
+				dot += values[j]*sv[j-first];
+			}
+			slotDots[i] = dot;
+		}
+	}
+}
+
+/**
+ * Classify the window of one scale from the dot products in the history
+ * @return label 0 if the history doesn't hold enough frames for the scale
+ * yet or the newest frame was not fit to classify
+ */
+GestureSpot GestureSpotter::SpotScale(int scale)
+{
+	GestureSpot spot;
+	spot.label = 0;
+	spot.frames = scales[scale];
+	spot.score = 0.0;
+	if(numberOfFrames<scales[scale] || !classifiable)
+	{
+		return spot;
+	}
+
+	std::fill(kernel.begin(),kernel.end(),0.0);
+	double norm = 0.0;
+	for(int k=0;k<SLOTS;k++)
+	{
+		int frame = (newest-ages[scale][k]+historyLength)%historyLength;
+		const double* slotDots = &dots[((size_t)frame*SLOTS+k)*numSV];
+		for(int i=0;i<numSV;i++)
+		{
+			kernel[i] += slotDots[i];
+		}
+		norm += norms[(size_t)frame*SLOTS+k];
+	}
+	const struct svm_parameter& param = model->param;
+	for(int i=0;i<numSV;i++)
+	{
+		switch(param.kernel_type)
+		{
+			case POLY:
+				kernel[i] = Powi(param.gamma*kernel[i]+param.coef0,param.degree);
+				break;
+			case RBF:
+				kernel[i] = exp(-param.gamma*(norm+supportNorms[i]-2*kernel[i]));
+				break;
+			case SIGMOID:
+				kernel[i] = tanh(param.gamma*kernel[i]+param.coef0);
+				break;
+			default: // LINEAR
+				break;
+		}
+	}
+
+	// the one-vs-one decisions and vote of svm_predict_values
+	int nrClass = model->nr_class;
+	int start[SPOTTER_MAX_CLASSES];
+	start[0] = 0;
+	for(int i=1;i<nrClass;i++)
+	{
+		start[i] = start[i-1]+model->nSV[i-1];
+	}
+	double decisions[SPOTTER_MAX_CLASSES*(SPOTTER_MAX_CLASSES-1)/2];
+	int votes[SPOTTER_MAX_CLASSES] = {0};
+	int p = 0;
+	for(int i=0;i<nrClass;i++)
+	{
+		for(int j=i+1;j<nrClass;j++)
+		{
+			double sum = 0.0;
+			const double* coef1 = model->sv_coef[j-1];
+			const double* coef2 = model->sv_coef[i];
+			for(int n=start[i];n<start[i]+model->nSV[i];n++)
+			{
+				sum += coef1[n]*kernel[n];
+			}
+			for(int n=start[j];n<start[j]+model->nSV[j];n++)
+			{
+				sum += coef2[n]*kernel[n];
+			}
+			sum -= model->rho[p];
+			decisions[p++] = sum;
+			votes[sum>0 ? i : j]++;
+		}
+	}
+	int winner = 0;
+	for(int i=1;i<nrClass;i++)
+	{
+		if(votes[i]>votes[winner])
+		{
+			winner = i;
+		}
+	}
+	spot.label = model->label[winner];
+	spot.score = nrClass<2 ? 0.0 : HUGE_VAL;
+	p = 0;
+	for(int i=0;i<nrClass;i++)
+	{
+		for(int j=i+1;j<nrClass;j++,p++)
+		{
+			if(i==winner)
+			{
+				spot.score = std::min(spot.score,decisions[p]);
+			}
+			else if(j==winner)
+			{
+				spot.score = std::min(spot.score,-decisions[p]);
+			}
+		}
+	}
+	return spot;
+}
+
+/**
+ * Classify every scale
+ * @return the scale with the best score, label 0 if no scale could be
+ * classified
+ */
+GestureSpot GestureSpotter::Spot()
+{
+	GestureSpot best;
+	best.label = 0;
+	best.frames = 0;
+	best.score = 0.0;
+	for(int i=0;i<numScales;i++)
+	{
+		GestureSpot spot = SpotScale(i);
+		if(spot.label!=0 && (best.label==0 || spot.score>best.score))
+		{
+			best = spot;
+		}
+	}
+	return best;
+}
+
+/**
+ * The time-normalized window of a scale, what SpotScale classifies
+ * @param window FEATURES+1 nodes, set to features 1 to FEATURES and a
+ * terminating node with index -1
+ */
+void GestureSpotter::GetWindow(int scale, struct svm_node* window) const
+{
+	const int frameFeatures = GestureRecognizer::FRAME_FEATURES;
+	for(int i=0;i<GestureRecognizer::FEATURES;i++)
+	{
+		window[i].index = i+1;
+	}
+	window[GestureRecognizer::FEATURES].index = -1;
+	window[GestureRecognizer::FEATURES].value = 0.0;
+	// oldest slot first so newer frames overwrite what they share with it
+	for(int k=SLOTS-1;k>=0;k--)
+	{
+		int frame = (newest-ages[scale][k]+historyLength)%historyLength;
+		int offset = GestureRecognizer::FrameOffset(k);
+		for(int j=offset<0 ? -offset : 0;j<frameFeatures && offset+j<GestureRecognizer::FEATURES;j++)
+		{
+			window[offset+j].value = frames[(size_t)frame*frameFeatures+j];
+		}
+	}
+}
+
+const struct svm_model* GestureSpotter::GetModel() const
+{
+	return model;
+}
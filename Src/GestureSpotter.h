@@ -0,0 +1,82 @@
+/*************************************************
+ * GestureSpotter.h
+ *
+ * Spots gestures performed faster or slower than the recognizer's 2 second
+ * window. One history of frames is kept and windows of several lengths
+ * (scales) are classified with the same model, each time-normalized to the
+ * model's FRAMES frames: slot k of the model's window (k frames back) takes
+ * the frame round(k*scale/FRAMES) back. A scale of FRAMES is exactly what
+ * GestureRecognizer classifies.
+ *
+ * Every kernel but precomputed only depends on the window through its dot
+ * product with each support vector (and its norm for RBF), and a dot
+ * product is a sum over the window's slots. So when a frame arrives its
+ * dot product with each slot of every support vector is computed once and
+ * kept while the frame is in the history; a scale only adds up the
+ * products of the frames it puts in each slot. A frame costs about one
+ * classify of multiply-adds however many scales there are, plus
+ * WINDOW_FRAMES additions per support vector and scale.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef GESTURE_SPOTTER_H
+#define GESTURE_SPOTTER_H
+
+#include "GestureRecognizer.h"
+#include "svm.h"
+#include <vector>
+
+#define SPOTTER_MAX_SCALES 8
+#define SPOTTER_MAX_CLASSES 16
+
+struct GestureSpot
+{
+	int label; // 0 if no scale could be classified
+	int frames; // the scale, how many frames the gesture took
+	double score; // smallest margin the label won its one-vs-one contests by, > 0 if it won them all
+};
+
+class GestureSpotter
+{
+public:
+	static const int SLOTS = GestureRecognizer::WINDOW_FRAMES;
+
+private:
+	struct svm_model* model;
+	int numSV;
+	std::vector<double> supportVectors; // dense, FEATURES per support vector
+	std::vector<double> supportNorms; // squared norm of each support vector
+
+	int scales[SPOTTER_MAX_SCALES]; // window lengths in frames, shortest first
+	int ages[SPOTTER_MAX_SCALES][SLOTS]; // frames back each slot takes at each scale
+	int numScales;
+
+	int historyLength; // frames kept, enough for the longest scale
+	int newest; // index of the newest frame in the history
+	int numberOfFrames; // frames seen, at most historyLength
+	bool classifiable;
+	std::vector<double> frames; // FRAME_FEATURES per frame
+	std::vector<double> dots; // per frame, slot and support vector
+	std::vector<double> norms; // squared norm of each slot of each frame
+	std::vector<double> kernel; // kernel value of each support vector
+
+	GestureSpotter(const GestureSpotter& other) = delete;
+	GestureSpotter& operator=(const GestureSpotter& other) = delete;
+
+public:
+	GestureSpotter(char* pathToModel);
+	~GestureSpotter();
+
+	bool AddScale(int frames);
+	int GetNumScales() const;
+	int GetScaleFrames(int scale) const;
+	void Reset();
+	void UpdateFeatures(const UserSkeleton& skeleton, bool classify = true);
+	GestureSpot Spot();
+	GestureSpot SpotScale(int scale);
+	void GetWindow(int scale, struct svm_node* window) const;
+	const struct svm_model* GetModel() const;
+};
+
+#endif
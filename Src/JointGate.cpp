@@ -0,0 +1,90 @@
+/******************************************************************************
+ * JointGate.cpp
+ *
+ * Fills in low confidence joints and gates frames that can't be classified.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "JointGate.h"
+
+/**
+ * Constructor
+ * @param maxHoldFrames how many frames a lost joint keeps its last valid
+ * position before it counts as missing
+ * @param maxInvalidJoints how many joints of a frame may be below the
+ * confidence threshold (and held) with the frame still classified
+ * @param requiredJoints mask of the SkeletonJoints the recognizer uses,
+ * only these can gate a frame
+ */
+JointGate::JointGate(int maxHoldFrames, int maxInvalidJoints, XnUInt32 requiredJoints)
+{
+	this->maxHoldFrames = maxHoldFrames;
+	this->maxInvalidJoints = maxInvalidJoints;
+	this->requiredJoints = requiredJoints;
+	Reset();
+}
+
+/**
+ * Forget every joint, use when the gate is handed to a new user
+ */
+void JointGate::Reset()
+{
+	for(int i=0;i<SKELETON_NUM_JOINTS;i++)
+	{
+		age[i] = -1;
+	}
+	stats.frames = 0;
+	stats.framesGated = 0;
+	stats.jointsHeld = 0;
+}
+
+/**
+ * Replace every invalid joint of the skeleton that was seen recently with
+ * its last valid position, and remember the valid ones.
+ *
+ * @return true if the frame should be classified: no more than
+ * maxInvalidJoints were invalid and every one of them could be held.
+ * The skeleton is filled in either way so the feature window stays in step.
+ */
+bool JointGate::Apply(UserSkeleton& skeleton)
+{
+	int invalid = 0;
+	bool missing = false;
+	for(int i=0;i<SKELETON_NUM_JOINTS;i++)
+	{
+		if(skeleton.validJoints & (1<<i))
+		{
+			held[i] = skeleton.GetJoint(i);
+			age[i] = 0;
+			continue;
+		}
+		bool required = (requiredJoints & (1<<i))!=0;
+		if(required)
+		{
+			invalid++;
+		}
+		if(age[i]>=0 && age[i]<maxHoldFrames)
+		{
+			age[i]++;
+			skeleton.SetJoint(i,held[i]);
+			stats.jointsHeld++;
+		}
+		else if(required)
+		{
+			missing = true;
+		}
+	}
+	stats.frames++;
+	if(missing || invalid>maxInvalidJoints)
+	{
+		stats.framesGated++;
+		return false;
+	}
+	return true;
+}
+
+JointGateStats JointGate::GetStats() const
+{
+	return stats;
+}
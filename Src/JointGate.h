@@ -0,0 +1,51 @@
+/*************************************************
+ * JointGate.h
+ *
+ * Keeps low confidence joints out of the features. OpenNI still reports a
+ * position for a joint it has lost (occluded, out of view), but that
+ * position is garbage. The gate replaces such a joint with the last
+ * position it was seen at, for a limited time, and decides whether the frame
+ * is still good enough to classify.
+ *
+ * One gate per tracked user since it remembers that user's joints.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef JOINT_GATE_H
+#define JOINT_GATE_H
+
+#include "SkeletonFrame.h"
+
+#define JOINT_GATE_DEFAULT_MAX_HOLD 15 // frames, half a second at 30 Hz
+#define JOINT_GATE_DEFAULT_MAX_INVALID 1
+#define JOINT_GATE_DEFAULT_REQUIRED SKELETON_ARM_JOINTS
+
+struct JointGateStats
+{
+	XnUInt64 frames; // frames passed through the gate
+	XnUInt64 framesGated; // frames not fit to classify
+	XnUInt64 jointsHeld; // joints replaced with their last valid position
+};
+
+class JointGate
+{
+private:
+	int maxHoldFrames;
+	int maxInvalidJoints;
+	XnUInt32 requiredJoints; // joints that decide whether a frame is gated
+	/**
+	 * Last valid position of each joint and how many frames ago it was seen,
+	 * -1 if it never has been
+	 */
+	XnVector3D held[SKELETON_NUM_JOINTS];
+	int age[SKELETON_NUM_JOINTS];
+	JointGateStats stats;
+public:
+	JointGate(int maxHoldFrames = JOINT_GATE_DEFAULT_MAX_HOLD, int maxInvalidJoints = JOINT_GATE_DEFAULT_MAX_INVALID, XnUInt32 requiredJoints = JOINT_GATE_DEFAULT_REQUIRED);
+	void Reset();
+	bool Apply(UserSkeleton& skeleton);
+	JointGateStats GetStats() const;
+};
+
+#endif
@@ -11,7 +11,25 @@
  * 
  * Author: Aaron Pulver <atp1317@rit.edu>
  * 
- * Usage: ./KinectRecording <outputFile.txt> <numberOfSamples> <classLabel>
+ * Usage: ./KinectRecording <outputFile.txt> <numberOfSamples> <classLabel> [skeletonLog.bin] [-p] [-c]
+ * 
+ * Every tracked user is recorded at the same time, each with their own
+ * countdown, until each of them has numberOfSamples samples. Samples go to
+ * outputFile.txt, or with -p to one file per user (outputFile.user1.txt...).
+ * 
+ * With -c there is no countdown. The user repeats the gesture with a short
+ * pause in between and each one is cut out of the stream by its motion
+ * (see MotionSegmenter), several times more samples per minute.
+ * 
+ * With -r the last few seconds of frames are kept. Any key but q then saves
+ * the last 2 seconds of every user as a sample, and a user who starts the
+ * gesture just before "Perform Gesture!" has the sample taken from their
+ * actual start instead of missing it.
+ * 
+ * If a skeleton log is given, every joint of every tracked user is also
+ * logged for every frame, along with where each sample ended. The session
+ * can then be replayed without a Kinect, and LogToFeatures can regenerate
+ * the samples with a different window or joint set.
  * 
  * Note: Requires root access (sudo) to access Kinect
  * ********************************************/
@@ -24,7 +42,16 @@
 #include <XnCppWrapper.h>
 #include <XnPropNames.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
 #include "GestureRecognizer.h"
+#include "GesturePipeline.h"
+#include "SkeletonSource.h"
+#include "SampleWriter.h"
+#include "FrameResampler.h"
+#include "JointGate.h"
+#include "MotionSegmenter.h"
+#include "SkeletonHistory.h"
 
 #define CLASS_LABEL 1
 
@@ -38,14 +65,61 @@
 xn::Context g_Context;
 xn::UserGenerator g_UserGenerator;
 
+/**
+ * Countdown and feature window of one user being recorded
+ */
+struct UserRecording
+{
+	GestureRecognizer gestureRecognizer;
+	JointGate jointGate; // holds this user's lost joints
+	MotionSegmenter segmenter; // finds gestures in continuous mode
+	bool started; // seen at least once
+	bool inFrame; // seen in the last grid frame
+	int frames;
+	int numSamples;
+	int gatedFrames; // frames of the current sample with unreliable joints
+	XnUInt64 promptFrame; // grid frame of the last "Perform Gesture!"
+	XnUInt64 onsetFrame; // grid frame the last motion started, 0 for none
+	SampleWriter* output; // the shared output or this user's own file
+};
+
+/**
+ * Everything the recording loop keeps between frames
+ */
+struct RecordingState
+{
+	UserRecording users[SKELETON_MAX_USERS+1]; // indexed by user id [1-15]
+	int sampleSize;
+	int classLabel;
+	bool perUserFiles;
+	bool continuous; // segment gestures by motion instead of counting down
+	const char* outputPath;
+	SampleWriter output; // formats and writes samples on its own thread
+	FrameResampler resampler; // one frame every 1/30 s whatever the sensor delivers
+	SkeletonFrame gridFrame;
+	XnUInt64 gridFrames; // grid frames so far, the index of the newest one
+	SkeletonLogWriter log; // optional raw skeleton log
+	/**
+	 * Optional history of the last few seconds of grid frames, and scratch
+	 * space to turn a window of it into a sample
+	 */
+	SkeletonHistory* history;
+	GestureRecognizer historyRecognizer;
+	JointGate historyGate;
+	const UserSkeleton* historyWindow[GestureRecognizer::FRAMES];
+};
+
+/**
+ * How early before "Perform Gesture!" a user may start and still have the
+ * sample taken from their actual start
+ */
+#define EARLY_START_FRAMES 30
+
 // Called when a new user is detected
 void XN_CALLBACK_TYPE
 User_NewUser(xn::UserGenerator& generator, XnUserID nId, void* pCookie) {
 	printf("New User: %d\n", nId);
-	if(nId==1)
-	{
-		g_UserGenerator.GetPoseDetectionCap().StartPoseDetection(POSE_TO_USE, nId);
-	}
+	g_UserGenerator.GetPoseDetectionCap().StartPoseDetection(POSE_TO_USE, nId);
 }
 // Called when a user was lost
 void XN_CALLBACK_TYPE
@@ -83,32 +157,389 @@ Calibration_End(xn::SkeletonCapability& capability, unsigned int nId,
 	}
 }
 
+/**
+ * Turns "samples.txt" into "samples.user3.txt"
+ */
+static void UserOutputPath(const char* path, XnUserID id, char* out, int size)
+{
+	const char* extension = strrchr(path,'.');
+	const char* slash = strrchr(path,'/');
+	if(extension==NULL || (slash!=NULL && extension<slash))
+	{
+		extension = path+strlen(path);
+	}
+	snprintf(out,size,"%.*s.user%u%s",(int)(extension-path),path,(unsigned int)id,extension);
+}
+
+/**
+ * Starts recording a user the first time they are seen
+ * @return false if their output file could not be opened
+ */
+static bool StartUser(RecordingState* state, XnUserID id)
+{
+	UserRecording& user = state->users[id];
+	user.started = true;
+	user.frames = GestureRecognizer::FRAMES;
+	user.numSamples = -1;
+	user.gatedFrames = 0;
+	user.jointGate.Reset();
+	user.segmenter.Reset();
+	user.promptFrame = 0;
+	user.onsetFrame = 0;
+	user.output = &state->output;
+	if(state->perUserFiles)
+	{
+		char path[1024];
+		UserOutputPath(state->outputPath,id,path,sizeof(path));
+		user.output = new SampleWriter();
+		if(!user.output->Open(path))
+		{
+			delete user.output;
+			user.output = NULL;
+			return false;
+		}
+		printf("User %u: recording to %s\n",(unsigned int)id,path);
+	}
+	return true;
+}
+
+/**
+ * Writes the user's current window as a sample
+ */
+static void WriteUserSample(RecordingState* state, const SkeletonFrame& frame, XnUserID id)
+{
+	UserRecording& user = state->users[id];
+	user.output->WriteSample(state->classLabel,user.gestureRecognizer.GetFeatures());
+	if(state->log.IsOpen())
+	{
+		state->log.WriteSample(frame,id,state->classLabel);
+	}
+}
+
+/**
+ * Writes a sample for a user from frames already in the history
+ * @param framesBack how many grid frames before the newest the sample ends
+ * @return false if the user isn't in every frame of that window
+ */
+static bool WriteHistorySample(RecordingState* state, XnUserID id, int framesBack)
+{
+	if(!state->history->GetUserWindow(id,framesBack,GestureRecognizer::FRAMES,state->historyWindow))
+	{
+		return false;
+	}
+	state->historyGate.Reset();
+	for(int i=0;i<GestureRecognizer::FRAMES;i++)
+	{
+		UserSkeleton skeleton = *state->historyWindow[i];
+		state->historyGate.Apply(skeleton);
+		state->historyRecognizer.UpdateFeatures(skeleton,false);
+	}
+	state->users[id].output->WriteSample(state->classLabel,state->historyRecognizer.GetFeatures());
+	if(state->log.IsOpen())
+	{
+		// the marker goes on the first frame after the sample
+		if(framesBack>0)
+		{
+			state->log.WriteSample(state->history->FromBack(framesBack-1),id,state->classLabel);
+		}
+		else
+		{
+			SkeletonFrame next = state->history->FromBack(0);
+			next.sequence++;
+			state->log.WriteSample(next,id,state->classLabel);
+		}
+	}
+	return true;
+}
+
+/**
+ * Keypress: take the last 2 seconds of every user being recorded as a
+ * sample, with no extra capture time
+ */
+static void CaptureFromHistory(RecordingState* state)
+{
+	if(state->history->Size()==0)
+	{
+		return;
+	}
+	const SkeletonFrame& newest = state->history->FromBack(0);
+	for(int i=0;i<newest.nUsers;i++)
+	{
+		XnUserID id = newest.users[i].id;
+		if(id<1 || id>SKELETON_MAX_USERS)
+		{
+			continue;
+		}
+		UserRecording& user = state->users[id];
+		if(!user.started || user.output==NULL || user.numSamples>=state->sampleSize)
+		{
+			continue;
+		}
+		if(WriteHistorySample(state,id,0))
+		{
+			user.numSamples = user.numSamples<0 ? 1 : user.numSamples+1;
+			printf("User %u: captured the last 2 seconds, sample %d\n",(unsigned int)id,user.numSamples);
+		}
+		else
+		{
+			printf("User %u: not tracked for the last 2 seconds, nothing captured\n",(unsigned int)id);
+		}
+	}
+}
+
+/**
+ * Continuous mode: no countdown, every gesture the segmenter finds in the
+ * user's motion becomes a sample
+ * @param reliable false if the frame had too many low confidence joints
+ */
+static void RecordUserContinuous(RecordingState* state, const SkeletonFrame& frame, const UserSkeleton& skeleton, bool reliable)
+{
+	XnUserID id = skeleton.id;
+	UserRecording& user = state->users[id];
+	if(user.numSamples==-1)
+	{
+		printf("User %u: perform the gesture, pausing still between each one\n",(unsigned int)id);
+		user.numSamples = 0;
+	}
+	user.gestureRecognizer.UpdateFeatures(skeleton);
+	if(!reliable)
+	{
+		// unreliable joints move on their own, never cut a sample from them
+		if(user.segmenter.IsActive())
+		{
+			printf("User %u: gesture dropped, joints lost\n",(unsigned int)id);
+		}
+		user.segmenter.Reset();
+		return;
+	}
+	switch(user.segmenter.Update(user.gestureRecognizer.GetRecentMotionEnergy(SEGMENTER_ENERGY_FRAMES)))
+	{
+	case SEGMENT_READY:
+		WriteUserSample(state,frame,id);
+		user.numSamples++;
+		printf("User %u: sample %d (%d frames of motion)\n",(unsigned int)id,user.numSamples,user.segmenter.GetSegmentLength());
+		break;
+	case SEGMENT_TOO_SHORT:
+		printf("User %u: motion too short, ignored\n",(unsigned int)id);
+		break;
+	case SEGMENT_TOO_LONG:
+		printf("User %u: gesture longer than 2 seconds, ignored\n",(unsigned int)id);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Advances one user's countdown and records them for one frame of the
+ * 30 Hz grid
+ */
+static void RecordUser(RecordingState* state, const SkeletonFrame& frame, UserSkeleton skeleton)
+{
+	XnUserID id = skeleton.id;
+	UserRecording& user = state->users[id];
+	if(!user.started && !StartUser(state,id))
+	{
+		return;
+	}
+	if(user.output==NULL || user.numSamples >= state->sampleSize)
+	{
+		return;
+	}
+	if(!user.inFrame && user.numSamples!=-1)
+	{
+		// lost mid countdown or sample, start the countdown over
+		printf("User %u back, restarting %s\n",(unsigned int)id,state->continuous?"segmentation":"countdown");
+		user.frames = 61;
+		user.jointGate.Reset();
+		user.segmenter.Reset();
+	}
+	user.inFrame = true;
+	bool reliable = user.jointGate.Apply(skeleton);
+	if(state->continuous)
+	{
+		RecordUserContinuous(state,frame,skeleton,reliable);
+		return;
+	}
+	if(!reliable && user.frames>=0 && user.frames<GestureRecognizer::FRAMES)
+	{
+		user.gatedFrames++;
+	}
+
+	// get a full window of frames (2 seconds of data)
+	if(user.frames==GestureRecognizer::FRAMES)
+	{
+		if(user.numSamples!=-1)
+		{
+			if(user.gatedFrames>0)
+			{
+				printf("User %u warning: %d of %d frames had unreliable joints\n",(unsigned int)id,user.gatedFrames,GestureRecognizer::FRAMES);
+			}
+			int preRoll = user.segmenter.GetPreRoll();
+			bool early = state->history!=NULL && user.onsetFrame+EARLY_START_FRAMES>=user.promptFrame && user.onsetFrame<user.promptFrame;
+			// the user started before the prompt, take the window from their start
+			if(early && WriteHistorySample(state,id,(int)(state->gridFrames-(user.onsetFrame-preRoll+GestureRecognizer::FRAMES-1))))
+			{
+				printf("User %u started %d frames early, sample taken from the history\n",(unsigned int)id,(int)(user.promptFrame-user.onsetFrame));
+			}
+			else
+			{
+				WriteUserSample(state,frame,id);
+			}
+		}
+		user.numSamples++;
+		if(user.numSamples <state->sampleSize)
+		{
+			printf("User %u resting for 5 seconds... Samples Completed: %d\n",(unsigned int)id,user.numSamples);
+		}
+		else
+		{
+			printf("User %u completed %d samples\n",(unsigned int)id,user.numSamples);
+		}
+	}
+	else if(user.frames==90 || user.frames==120 || user.frames==150 || user.frames==180)
+	{
+		printf("User %u: %d\n",(unsigned int)id,(210-user.frames)/30);
+	}
+	else if(user.frames==210)
+	{
+		printf("User %u: Perform Gesture!\n",(unsigned int)id);
+		user.frames = -1; // increment at end to get to 0
+		user.gatedFrames = 0;
+		user.promptFrame = state->gridFrames;
+	}
+	user.gestureRecognizer.UpdateFeatures(skeleton);
+	user.frames++;
+	// watch for the user starting before the prompt
+	if(state->history!=NULL)
+	{
+		if(!reliable)
+		{
+			user.segmenter.Reset();
+		}
+		else
+		{
+			// a gesture taken early by the next motion also means an onset
+			SegmentEvent event = user.segmenter.Update(user.gestureRecognizer.GetRecentMotionEnergy(SEGMENTER_ENERGY_FRAMES));
+			if(event==SEGMENT_ONSET || (event==SEGMENT_READY && user.segmenter.IsActive()))
+			{
+				user.onsetFrame = state->gridFrames;
+			}
+		}
+	}
+}
+
+/**
+ * Records every tracked user for one frame of the 30 Hz grid
+ */
+static void RecordGridFrame(RecordingState* state, const SkeletonFrame& frame)
+{
+	state->gridFrames++;
+	if(state->history!=NULL)
+	{
+		state->history->Push(frame);
+	}
+	bool inFrame[SKELETON_MAX_USERS+1] = {false};
+	for(int i=0;i<frame.nUsers;i++)
+	{
+		XnUserID id = frame.users[i].id;
+		if(id>=1 && id<=SKELETON_MAX_USERS)
+		{
+			RecordUser(state,frame,frame.users[i]);
+			inFrame[id] = true;
+		}
+	}
+	for(int id=1;id<=SKELETON_MAX_USERS;id++)
+	{
+		state->users[id].inFrame = inFrame[id];
+	}
+}
+
+/**
+ * Runs on the main thread for every frame the capture thread reads.
+ * Resamples it so a dropped or repeated sensor frame doesn't stretch or
+ * squash the 2 second window.
+ */
+void RecordFrame(void* pCookie, const SkeletonFrame& frame)
+{
+	RecordingState* state = (RecordingState*)pCookie;
+	state->resampler.Push(frame);
+	while(state->resampler.Next(state->gridFrame))
+	{
+		RecordGridFrame(state,state->gridFrame);
+	}
+}
+
+/**
+ * Recording is over once every user who showed up has all their samples
+ */
+static bool RecordingDone(const RecordingState& state)
+{
+	bool anyStarted = false;
+	for(int id=1;id<=SKELETON_MAX_USERS;id++)
+	{
+		const UserRecording& user = state.users[id];
+		if(user.started && user.output!=NULL)
+		{
+			anyStarted = true;
+			if(user.numSamples < state.sampleSize)
+			{
+				return false;
+			}
+		}
+	}
+	return anyStarted;
+}
+
 int main(int argc, char* argv[]) {
 	// check for file
 	if(argc<4)
 	{
-		printf("Missing arguments\nUsage: ./KinectTraining <outputFile.txt> <numberOfSamples> <classLabel>\n");
+		printf("Missing arguments\nUsage: ./KinectTraining <outputFile.txt> <numberOfSamples> <classLabel> [skeletonLog.bin] [-p] [-c] [-r seconds]\n");
 		return -1;
 	}
-	GestureRecognizer gestureRecognizer = GestureRecognizer();
-	int frames = 60;
-	int sampleSize = 0;
-	int numSamples = -1;
-	int classLabel = 0;
-	sscanf(argv[3], "%d", &classLabel);
-	sscanf(argv[2], "%d", &sampleSize);
-	XnSkeletonJointPosition head;
-	XnSkeletonJointPosition torso;
-	XnSkeletonJointPosition leftShoulder;
-	XnSkeletonJointPosition rightShoulder;
-	XnSkeletonJointPosition leftElbow;
-	XnSkeletonJointPosition rightElbow;
-	XnSkeletonJointPosition leftHand;
-	XnSkeletonJointPosition rightHand;
-
-	FILE* fileOutput;
-
-	printf("Recording %d Samples labeled: %d.\nPress any key to exit gracefully!\n",sampleSize,classLabel);
+	RecordingState state;
+	state.sampleSize = 0;
+	state.classLabel = 0;
+	state.perUserFiles = false;
+	state.continuous = false;
+	state.gridFrames = 0;
+	state.history = NULL;
+	state.outputPath = argv[1];
+	const char* logPath = NULL;
+	for(int id=0;id<=SKELETON_MAX_USERS;id++)
+	{
+		state.users[id].started = false;
+		state.users[id].inFrame = false;
+		state.users[id].output = NULL;
+	}
+	sscanf(argv[3], "%d", &state.classLabel);
+	sscanf(argv[2], "%d", &state.sampleSize);
+	for(int i=4;i<argc;i++)
+	{
+		if(strcmp(argv[i],"-p")==0)
+		{
+			state.perUserFiles = true;
+		}
+		else if(strcmp(argv[i],"-c")==0)
+		{
+			state.continuous = true;
+		}
+		else if(strcmp(argv[i],"-r")==0 && i+1<argc)
+		{
+			// 30 grid frames per second, at least one sample and an early start
+			int frames = (int)(atof(argv[++i])*30);
+			state.history = new SkeletonHistory(frames>120 ? frames : 120);
+		}
+		else
+		{
+			logPath = argv[i];
+		}
+	}
+	// every frame of a sample matters, so stall the sensor rather than drop one
+	GesturePipeline pipeline(8, GesturePipeline::BLOCK);
+
+	printf("Recording %d Samples labeled: %d from every user.\nPress any key to exit gracefully!\n",state.sampleSize,state.classLabel);
 	XnStatus nRetVal = XN_STATUS_OK;
 	xn::Context context;
 	nRetVal = context.Init();
@@ -133,74 +564,77 @@ int main(int argc, char* argv[]) {
 	nRetVal = context.StartGeneratingAll();
 	CHECK_RC(nRetVal, "Generate");
 
-	// open file
-	fileOutput=fopen(argv[1],"w");
-
-	// loop until keyboard hit
-	while (!xnOSWasKeyboardHit() && numSamples < sampleSize)
+	// open file, unless every user gets their own
+	if(!state.perUserFiles && !state.output.Open(state.outputPath))
 	{
-		nRetVal = context.WaitAndUpdateAll();
-		CHECK_RC(nRetVal, "WaitAndUpdatAll");
-		XnUserID aUsers[5];
-		XnUInt16 nUsers = 5;
-
-		nRetVal = g_UserGenerator.GetUsers(aUsers, nUsers);
-		CHECK_RC(nRetVal, "GetUsers");
+		return -1;
+	}
 
-		// for first user get their joint locations and print them
-		if (g_UserGenerator.GetSkeletonCap().IsTracking(aUsers[0])) {
-			g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(aUsers[0], XN_SKEL_TORSO, torso);
-			g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(aUsers[0], XN_SKEL_LEFT_SHOULDER, leftShoulder);
-			g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(aUsers[0], XN_SKEL_LEFT_ELBOW, leftElbow);
-			g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(aUsers[0], XN_SKEL_LEFT_HAND, leftHand);
-			g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(aUsers[0], XN_SKEL_RIGHT_SHOULDER, rightShoulder);
-			g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(aUsers[0], XN_SKEL_RIGHT_ELBOW, rightElbow);
-			g_UserGenerator.GetSkeletonCap().GetSkeletonJointPosition(aUsers[0], XN_SKEL_RIGHT_HAND, rightHand);
+	// the capture thread reads the sensor, this thread records
+	OpenNISkeletonSource source(&context, &g_UserGenerator);
+	if(logPath!=NULL && state.log.Open(logPath))
+	{
+		source.SetLog(&state.log);
+	}
+	pipeline.Start(SkeletonSource::Capture, &source);
 
-			// get 60 frames (2 seconds of data)
-			if(frames==60)
-			{
-				if(numSamples!=-1)
-				{
-					gestureRecognizer.PrintFeatures(fileOutput,classLabel);
-				}
-				numSamples++;
-				if(numSamples <sampleSize)
-				{
-					printf("Resting for 5 seconds... Samples Completed: %d\n",numSamples);
-				}
-			}
-			else if(frames==90)
-			{
-				printf("4\r");
-				fflush(stdout);
-			}
-			else if(frames==120)
-			{
-				printf("3\r");
-				fflush(stdout);
-			}
-			else if(frames==150)
-			{
-				printf("2\r");
-				fflush(stdout);
-			}
-			else if(frames==180)
-			{
-				printf("1\r");
-				fflush(stdout);
-			}
-			else if(frames==210)
+	// loop until keyboard hit, or q when keys capture from the history
+	while (!RecordingDone(state))
+	{
+		if(xnOSWasKeyboardHit())
+		{
+			char key = xnOSReadCharFromInput();
+			if(state.history==NULL || key=='q' || key=='Q')
 			{
-				printf("Perform Gesture!\n");
-				frames = -1; // increment at end to get to 0
+				break;
 			}
-			gestureRecognizer.UpdateFeatures(torso.position,leftShoulder.position,leftElbow.position,leftHand.position,rightShoulder.position,rightElbow.position,rightHand.position);
-			frames++;
+			CaptureFromHistory(&state);
+		}
+		if(!pipeline.ProcessFrame(RecordFrame, &state, 100) && !pipeline.IsRunning())
+		{
+			break;
 		}
 	}
-	fclose(fileOutput);
+	pipeline.Stop();
+	state.output.Close();
+	for(int id=1;id<=SKELETON_MAX_USERS;id++)
+	{
+		if(state.users[id].output!=NULL && state.users[id].output!=&state.output)
+		{
+			state.users[id].output->Close();
+		}
+	}
+	state.log.Close();
+	delete state.history;
+	nRetVal = pipeline.GetCaptureStatus();
+	CHECK_RC(nRetVal, "Capture");
 	printf("Recording Completed\n");
+	pipeline.PrintStats(stdout);
+	FrameResamplerStats resampled = state.resampler.GetStats();
+	printf("Resampled %llu frames to %llu at %.0f Hz (%llu duplicates, %llu gaps)\n",
+			(unsigned long long)resampled.framesIn,(unsigned long long)resampled.framesOut,state.resampler.GetRate(),
+			(unsigned long long)resampled.duplicates,(unsigned long long)resampled.gaps);
+	for(int id=1;id<=SKELETON_MAX_USERS;id++)
+	{
+		UserRecording& user = state.users[id];
+		if(user.output==NULL)
+		{
+			continue;
+		}
+		JointGateStats gated = user.jointGate.GetStats();
+		printf("User %d: %d samples. Low confidence: %llu of %llu frames gated, %llu joints held\n",id,user.numSamples<0?0:user.numSamples,
+				(unsigned long long)gated.framesGated,(unsigned long long)gated.frames,(unsigned long long)gated.jointsHeld);
+		if(user.output!=&state.output)
+		{
+			user.output->PrintStats(stdout);
+			delete user.output;
+			user.output = NULL;
+		}
+	}
+	if(!state.perUserFiles)
+	{
+		state.output.PrintStats(stdout);
+	}
 	context.Release();
 	return 0;
 }
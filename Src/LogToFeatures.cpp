@@ -0,0 +1,383 @@
+/************************************************
+ * LogToFeatures.cpp
+ * 
+ * Regenerates LIBSVM feature files from a skeleton log written by
+ * KinectRecording, so the window length, joint set or normalization can be
+ * changed without recording everyone again.
+ * 
+ * The log is replayed the way KinectRecording saw it live: resampled onto
+ * the 30 Hz grid, with each user's lost joints held by a JointGate. With no
+ * layout options the frames go through a GestureRecognizer, so the samples
+ * have exactly the layout KinectRecording writes and Models/Model.txt was
+ * trained on (its 17 feature shift included). -w, -j or -r switch to a
+ * window of whole frames of the chosen joints instead, the layout of the
+ * other recognizer types.
+ * 
+ * By default one sample is written for every sample marker in the log,
+ * made of the window of frames that ended there. With -s a sample is also
+ * written every <stride> frames of every user.
+ * 
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * 
+ * Usage: ./LogToFeatures <skeletonLog.bin> <outputFile.txt> [options]
+ *   -w <frames>       window length in frames (default 60)
+ *   -s <frames>       also write a sliding window every <frames> frames
+ *   -l <label>        label for sliding windows, overrides marker labels
+ *   -j <joint,...>    joints to use (default leftShoulder,leftElbow,
+ *                     leftHand,rightShoulder,rightElbow,rightHand)
+ *   -r <joint|none>   joint positions are relative to (default torso)
+ * ********************************************/
+
+#include "FrameResampler.h"
+#include "GestureRecognizer.h"
+#include "JointGate.h"
+#include "SkeletonLog.h"
+#include "SkeletonSource.h"
+#include "SampleWriter.h"
+#include <algorithm>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * A labeled sample found in the log
+ */
+struct SampleMarker
+{
+	int userId;
+	XnUInt32 sequence;
+	int label;
+
+	bool operator<(const SampleMarker& other) const
+	{
+		if(userId!=other.userId)
+		{
+			return userId<other.userId;
+		}
+		return sequence<other.sequence;
+	}
+};
+
+/**
+ * The last windowSize frames of features for one user
+ */
+struct UserWindow
+{
+	GestureRecognizer recognizer; // the window when no layout was chosen
+	JointGate gate;
+	std::vector<double> features; // ring of windowSize frames otherwise
+	int newest;
+	int count;
+	int sinceLastSample;
+	size_t nextMarker; // index into the sorted markers
+	XnUInt64 lastGridFrame; // grid frame the user was last in
+};
+
+/**
+ * Options read from the command line
+ */
+struct Options
+{
+	bool customLayout; // -w, -j or -r given, whole frames of the joints below
+	int windowSize;
+	int stride;
+	bool overrideLabel;
+	int label;
+	std::vector<int> joints; // SkeletonJoint
+	int reference; // SkeletonJoint, -1 for absolute positions
+};
+
+/**
+ * Queue the user's current window as one LIBSVM sample
+ * @param nodes scratch space for windowSize*frameSize+1 nodes
+ */
+static void WriteSample(SampleWriter& output, const Options& options, const UserWindow& window, int label, std::vector<svm_node>& nodes)
+{
+	if(!options.customLayout)
+	{
+		output.WriteSample(label,window.recognizer.GetFeatures());
+		return;
+	}
+	int frameSize = options.joints.size()*3;
+	int feature = 0;
+	for(int i=options.windowSize-1;i>=0;i--)
+	{
+		int slot = (window.newest-i+options.windowSize)%options.windowSize;
+		const double* frame = &window.features[slot*frameSize];
+		for(int j=0;j<frameSize;j++)
+		{
+			nodes[feature].index=feature+1;
+			nodes[feature].value=frame[j];
+			feature++;
+		}
+	}
+	nodes[feature].index=-1;
+	output.WriteSample(label,&nodes[0]);
+}
+
+/**
+ * The SkeletonJoint a joint of the log is stored as, by name
+ */
+static int SkeletonJointIndex(const char* name)
+{
+	int index = SkeletonLogJointIndex(name);
+	for(int j=0;index>=0 && j<SKELETON_NUM_JOINTS;j++)
+	{
+		if(SKELETON_JOINT_IDS[j]==SKELETON_LOG_JOINT_IDS[index])
+		{
+			return j;
+		}
+	}
+	return -1;
+}
+
+static bool ParseJoints(const char* list, std::vector<int>& joints)
+{
+	char buffer[512];
+	strncpy(buffer,list,sizeof(buffer)-1);
+	buffer[sizeof(buffer)-1]='\0';
+	joints.clear();
+	for(char* name=strtok(buffer,",");name!=NULL;name=strtok(NULL,","))
+	{
+		int index = SkeletonJointIndex(name);
+		if(index<0)
+		{
+			printf("Unknown joint %s\n",name);
+			return false;
+		}
+		joints.push_back(index);
+	}
+	return !joints.empty();
+}
+
+/**
+ * Write a sample for every marker of the user that ended before a frame
+ * @param sequence the frame's sequence number, 0xFFFFFFFF for every marker left
+ */
+static void WriteMarkedSamples(SampleWriter& output, const Options& options, const std::vector<SampleMarker>& markers, int userId,
+		UserWindow& window, XnUInt32 sequence, std::vector<svm_node>& nodes, long& samples, long& skipped)
+{
+	while(window.nextMarker<markers.size() && markers[window.nextMarker].userId==userId
+			&& markers[window.nextMarker].sequence<=sequence)
+	{
+		if(window.count>=options.windowSize)
+		{
+			WriteSample(output,options,window,options.overrideLabel?options.label:markers[window.nextMarker].label,nodes);
+			samples++;
+		}
+		else
+		{
+			skipped++;
+		}
+		window.nextMarker++;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if(argc<3)
+	{
+		printf("Missing arguments\nUsage: ./LogToFeatures <skeletonLog.bin> <outputFile.txt> [-w frames] [-s stride] [-l label] [-j joint,...] [-r joint|none]\n");
+		return -1;
+	}
+	Options options;
+	options.customLayout=false;
+	options.windowSize=GestureRecognizer::FRAMES;
+	options.stride=0;
+	options.overrideLabel=false;
+	options.label=0;
+	options.reference=SKELETON_TORSO;
+	ParseJoints("leftShoulder,leftElbow,leftHand,rightShoulder,rightElbow,rightHand",options.joints);
+	for(int i=3;i+1<argc;i+=2)
+	{
+		if(strcmp(argv[i],"-w")==0)
+		{
+			options.customLayout=true;
+			options.windowSize=atoi(argv[i+1]);
+		}
+		else if(strcmp(argv[i],"-s")==0)
+		{
+			options.stride=atoi(argv[i+1]);
+		}
+		else if(strcmp(argv[i],"-l")==0)
+		{
+			options.overrideLabel=true;
+			options.label=atoi(argv[i+1]);
+		}
+		else if(strcmp(argv[i],"-j")==0)
+		{
+			options.customLayout=true;
+			if(!ParseJoints(argv[i+1],options.joints))
+			{
+				return -1;
+			}
+		}
+		else if(strcmp(argv[i],"-r")==0)
+		{
+			options.customLayout=true;
+			options.reference = strcmp(argv[i+1],"none")==0 ? -1 : SkeletonJointIndex(argv[i+1]);
+			if(options.reference<0 && strcmp(argv[i+1],"none")!=0)
+			{
+				printf("Unknown joint %s\n",argv[i+1]);
+				return -1;
+			}
+		}
+		else
+		{
+			printf("Unknown option %s\n",argv[i]);
+			return -1;
+		}
+	}
+	if(options.windowSize<1)
+	{
+		printf("Window length must be at least 1 frame\n");
+		return -1;
+	}
+	// the gate decides on the joints the features are made of
+	XnUInt32 gateJoints = GestureRecognizer::JOINT_MASK;
+	if(options.customLayout)
+	{
+		gateJoints = options.reference>=0 ? 1u<<options.reference : 0;
+		for(size_t j=0;j<options.joints.size();j++)
+		{
+			gateJoints |= 1u<<options.joints[j];
+		}
+	}
+
+	// markers can be written after later frames, so collect them first
+	SkeletonLogReader log;
+	if(!log.Open(argv[1]))
+	{
+		return -1;
+	}
+	std::vector<SampleMarker> markers;
+	SkeletonLogRecord record;
+	long records = 0;
+	while(log.Read(record))
+	{
+		records++;
+		if(record.type==SKELETON_LOG_SAMPLE)
+		{
+			SampleMarker marker;
+			marker.userId=record.userId;
+			marker.sequence=record.sequence;
+			marker.label=record.label;
+			markers.push_back(marker);
+		}
+	}
+	log.Close();
+	std::sort(markers.begin(),markers.end());
+
+	ReplaySkeletonSource source(false);
+	if(!source.Open(argv[1]))
+	{
+		return -1;
+	}
+	SampleWriter output;
+	if(!output.Open(argv[2]))
+	{
+		return -1;
+	}
+
+	int frameSize = options.joints.size()*3;
+	std::vector<svm_node> nodes(options.windowSize*frameSize+1);
+	std::map<int,UserWindow> windows;
+	FrameResampler resampler;
+	SkeletonFrame captured;
+	SkeletonFrame frame;
+	XnUInt64 gridFrames = 0;
+	long samples = 0;
+	long skipped = 0;
+	while(source.NextFrame(captured)==XN_STATUS_OK)
+	{
+		resampler.Push(captured);
+		while(resampler.Next(frame))
+		{
+			gridFrames++;
+			for(int u=0;u<frame.nUsers;u++)
+			{
+				UserSkeleton skeleton = frame.users[u];
+				int userId = skeleton.id;
+				std::map<int,UserWindow>::iterator it = windows.find(userId);
+				if(it==windows.end())
+				{
+					it = windows.insert(std::make_pair(userId,UserWindow())).first;
+					UserWindow& window = it->second;
+					window.gate = JointGate(JOINT_GATE_DEFAULT_MAX_HOLD,JOINT_GATE_DEFAULT_MAX_INVALID,gateJoints);
+					window.features.resize(options.customLayout ? options.windowSize*frameSize : 0);
+					window.newest=options.windowSize-1;
+					window.count=0;
+					window.sinceLastSample=0;
+					window.nextMarker = std::lower_bound(markers.begin(),markers.end(),SampleMarker{userId,0,0})-markers.begin();
+					window.lastGridFrame=gridFrames;
+				}
+				UserWindow& window = it->second;
+				// samples that ended before this frame
+				WriteMarkedSamples(output,options,markers,userId,window,frame.sequence,nodes,samples,skipped);
+				// KinectRecording forgets held joints when a user comes back
+				if(window.lastGridFrame+1<gridFrames)
+				{
+					window.gate.Reset();
+				}
+				window.lastGridFrame=gridFrames;
+				window.gate.Apply(skeleton);
+				// add this frame
+				if(!options.customLayout)
+				{
+					window.recognizer.UpdateFeatures(skeleton,false);
+				}
+				else
+				{
+					window.newest=(window.newest+1)%options.windowSize;
+					double* features = &window.features[window.newest*frameSize];
+					const float* axes[3] = {skeleton.x,skeleton.y,skeleton.z};
+					for(size_t j=0;j<options.joints.size();j++)
+					{
+						for(int k=0;k<3;k++)
+						{
+							double value = axes[k][options.joints[j]];
+							if(options.reference>=0)
+							{
+								value -= axes[k][options.reference];
+							}
+							features[j*3+k]=value;
+						}
+					}
+				}
+				if(window.count<options.windowSize)
+				{
+					window.count++;
+				}
+				window.sinceLastSample++;
+				if(options.stride>0 && window.count>=options.windowSize && window.sinceLastSample>=options.stride)
+				{
+					WriteSample(output,options,window,options.label,nodes);
+					window.sinceLastSample=0;
+					samples++;
+				}
+			}
+		}
+	}
+	// samples that ended with the last frame of a user
+	for(std::map<int,UserWindow>::iterator it=windows.begin();it!=windows.end();++it)
+	{
+		WriteMarkedSamples(output,options,markers,it->first,it->second,0xFFFFFFFF,nodes,samples,skipped);
+	}
+	output.Close();
+	printf("Read %ld records, %d markers, %llu grid frames. Wrote %ld samples",records,(int)markers.size(),(unsigned long long)gridFrames,samples);
+	if(options.customLayout)
+	{
+		printf(" (%d frames x %d features)",options.windowSize,frameSize);
+	}
+	else
+	{
+		printf(" (GestureRecognizer layout, %d features)",GestureRecognizer::FEATURES);
+	}
+	if(skipped>0)
+	{
+		printf(", skipped %ld markers with too few frames",skipped);
+	}
+	printf("\n");
+	output.PrintStats(stdout);
+	return 0;
+}
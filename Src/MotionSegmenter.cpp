@@ -0,0 +1,168 @@
+/******************************************************************************
+ * MotionSegmenter.cpp
+ *
+ * Splits a continuous joint stream into gestures using motion energy.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "MotionSegmenter.h"
+
+/**
+ * Constructor
+ * @param windowFrames frames in a sample, the recognizer's window
+ * @param preRoll frames of the window before the detected onset
+ * @param onThreshold energy (mm moved per frame) that starts a gesture
+ * @param offThreshold energy below which a gesture can end
+ * @param minFrames shortest motion that counts as a gesture
+ * @param quietFrames frames the energy must stay below offThreshold to end
+ */
+MotionSegmenter::MotionSegmenter(int windowFrames, int preRoll, float onThreshold, float offThreshold, int minFrames, int quietFrames)
+{
+	this->windowFrames = windowFrames;
+	this->preRoll = preRoll;
+	this->onThreshold = onThreshold;
+	this->offThreshold = offThreshold;
+	this->minFrames = minFrames;
+	this->quietFrames = quietFrames;
+	Reset();
+}
+
+/**
+ * Drop any gesture in progress and forget the motion history
+ */
+void MotionSegmenter::Reset()
+{
+	state = IDLE;
+	framesSeen = 0;
+	windowPosition = 0;
+	segmentLength = 0;
+	completedLength = 0;
+	quietCount = 0;
+	energy = 0.0f;
+}
+
+/**
+ * Add the next frame of the user, after it was given to the recognizer
+ * @param energy the recognizer's motion energy of its newest frames,
+ * GetRecentMotionEnergy(SEGMENTER_ENERGY_FRAMES)
+ * @return what happened on this frame. On SEGMENT_READY the recognizer's
+ * window holds the sample. If the next motion cut the wait for the rest of
+ * the window short, the sample ends early and that motion is already being
+ * followed (IsActive), in place of its SEGMENT_ONSET.
+ */
+SegmentEvent MotionSegmenter::Update(double energy)
+{
+	this->energy = (float)energy;
+	framesSeen++;
+
+	switch(state)
+	{
+	case IDLE:
+		if(energy>onThreshold && framesSeen>preRoll)
+		{
+			state = ACTIVE;
+			windowPosition = preRoll+1;
+			segmentLength = 1;
+			quietCount = 0;
+			return SEGMENT_ONSET;
+		}
+		break;
+	case ACTIVE:
+		windowPosition++;
+		segmentLength++;
+		if(energy<offThreshold)
+		{
+			quietCount++;
+		}
+		else
+		{
+			quietCount = 0;
+		}
+		if(quietCount>=quietFrames)
+		{
+			segmentLength -= quietCount;
+			if(segmentLength<minFrames)
+			{
+				state = IDLE;
+				return SEGMENT_TOO_SHORT;
+			}
+			state = ENDED;
+		}
+		else if(windowPosition>=windowFrames)
+		{
+			state = SETTLING;
+			quietCount = 0;
+			return SEGMENT_TOO_LONG;
+		}
+		// a short window can already be complete when the gesture ends
+		if(state==ENDED && windowPosition>=windowFrames)
+		{
+			state = IDLE;
+			completedLength = segmentLength;
+			return SEGMENT_READY;
+		}
+		break;
+	case ENDED:
+		windowPosition++;
+		// the next motion started before this window was complete. The
+		// gesture is over and inside the window already, so take it now and
+		// follow the new motion from here.
+		if(energy>onThreshold)
+		{
+			completedLength = segmentLength;
+			state = ACTIVE;
+			windowPosition = preRoll+1;
+			segmentLength = 1;
+			quietCount = 0;
+			return SEGMENT_READY;
+		}
+		if(windowPosition>=windowFrames)
+		{
+			state = IDLE;
+			completedLength = segmentLength;
+			return SEGMENT_READY;
+		}
+		break;
+	case SETTLING:
+		quietCount = energy<offThreshold ? quietCount+1 : 0;
+		if(quietCount>=quietFrames)
+		{
+			state = IDLE;
+		}
+		break;
+	}
+	return SEGMENT_NONE;
+}
+
+/**
+ * Current motion energy, roughly how far the arm joints move per frame (mm)
+ */
+float MotionSegmenter::GetEnergy() const
+{
+	return energy;
+}
+
+/**
+ * Frames of motion in the last gesture, valid after SEGMENT_READY
+ */
+int MotionSegmenter::GetSegmentLength() const
+{
+	return completedLength;
+}
+
+/**
+ * Frames of a sample window before the onset
+ */
+int MotionSegmenter::GetPreRoll() const
+{
+	return preRoll;
+}
+
+/**
+ * True between an onset and the end of that gesture's window
+ */
+bool MotionSegmenter::IsActive() const
+{
+	return state==ACTIVE || state==ENDED;
+}
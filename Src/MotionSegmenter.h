@@ -0,0 +1,70 @@
+/*************************************************
+ * MotionSegmenter.h
+ *
+ * Finds gestures in a continuous stream of one user's joints so samples can
+ * be recorded without a countdown. It is fed the recognizer's motion energy
+ * over its newest few frames (GestureRecognizer::GetRecentMotionEnergy), so
+ * there is one definition of how much a user moves, the same the idle gate
+ * uses over the whole window. A gesture starts when the energy rises above
+ * one threshold and ends once it has stayed below a lower one for a few
+ * frames.
+ *
+ * A sample is the window of frames starting a little before the onset, the
+ * same length as the recognizer's window. The segmenter says when that
+ * window is complete, at which point the recognizer's features are exactly
+ * the sample, so nothing else has to be buffered.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef MOTION_SEGMENTER_H
+#define MOTION_SEGMENTER_H
+
+#include "SkeletonFrame.h"
+
+#define SEGMENTER_ENERGY_FRAMES 4 // newest frames of the recognizer's window the energy is taken over
+
+enum SegmentEvent
+{
+	SEGMENT_NONE,
+	SEGMENT_ONSET, // motion started
+	SEGMENT_READY, // a gesture ended and its window is complete, or the next motion started
+	SEGMENT_TOO_SHORT, // motion ended too quickly to be a gesture
+	SEGMENT_TOO_LONG, // motion did not end within the window
+};
+
+class MotionSegmenter
+{
+private:
+	enum State
+	{
+		IDLE, // waiting for an onset
+		ACTIVE, // in a gesture
+		ENDED, // gesture over, waiting for the rest of the window
+		SETTLING, // rejected, waiting for the motion to stop
+	};
+	int windowFrames;
+	int preRoll;
+	float onThreshold;
+	float offThreshold;
+	int minFrames;
+	int quietFrames;
+
+	State state;
+	int framesSeen;
+	int windowPosition; // frames since the start of the current sample window
+	int segmentLength; // frames of motion so far
+	int completedLength; // of the last gesture taken
+	int quietCount;
+	float energy;
+public:
+	MotionSegmenter(int windowFrames = 60, int preRoll = 6, float onThreshold = 8.0f, float offThreshold = 4.0f, int minFrames = 8, int quietFrames = 4);
+	void Reset();
+	SegmentEvent Update(double energy);
+	float GetEnergy() const;
+	int GetSegmentLength() const;
+	int GetPreRoll() const;
+	bool IsActive() const;
+};
+
+#endif
@@ -0,0 +1,230 @@
+/************************************************
+ * MotionThreshold.cpp
+ *
+ * Learns the motion energy below which a recognizer can skip its model and
+ * report the idle class (GestureRecognizerBase::SetIdleGate). Every sample
+ * of a labeled LIBSVM file is replayed frame by frame into a recognizer and
+ * its window's motion energy read at the end, so the energies are exactly
+ * what the recognizer sees live. The threshold is a fraction (-m) of the
+ * lowest energy of any gesture sample, so none of the training gestures
+ * would have been skipped.
+ *
+ * With -o the threshold and idle label are written for
+ * GestureRecognizerBase::LoadIdleGate. Write them next to the model
+ * (Models/Model.idle.txt) and the Example and ReplayBenchmark pick them up.
+ *
+ * With -t the threshold is tried on other samples: each one is replayed
+ * after a background sample as in StrideBenchmark, with and without the
+ * gate, and the accuracy at its end, the share of predictions that
+ * skipped the model and the cost per frame are reported, along with how
+ * many idle and gesture samples would skip the model on their own.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ *
+ * Usage: ./MotionThreshold <samples.txt> <idleLabel> [-m fraction] [-o idle.txt] [-t testSamples.txt model.txt]
+ * ********************************************/
+
+#include "GestureRecognizer.h"
+#include "SampleReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+struct Sample
+{
+	int label;
+	std::vector<double> values; // every feature of the window
+};
+
+/**
+ * Read every sample of a file
+ */
+static bool ReadSamples(const char* path, std::vector<Sample>& samples)
+{
+	SampleReader input;
+	if(!input.Open(path))
+	{
+		return false;
+	}
+	Sample read;
+	read.values.resize(GestureRecognizer::FEATURES);
+	while(input.Read(read.label,read.values))
+	{
+		samples.push_back(read);
+	}
+	if(samples.empty())
+	{
+		printf("No samples in %s\n",path);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Feed every frame of a sample to the recognizer, oldest first
+ */
+static void Replay(GestureRecognizer& recognizer, const Sample& sample)
+{
+	UserSkeleton skeleton;
+	for(int back=GestureRecognizer::WINDOW_FRAMES-1;back>=0;back--)
+	{
+		GestureRecognizer::WindowFrame(&sample.values[0],back,skeleton);
+		recognizer.UpdateFeatures(skeleton);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if(argc<3)
+	{
+		printf("Missing arguments\nUsage: ./MotionThreshold <samples.txt> <idleLabel> [-m fraction] [-o idle.txt] [-t testSamples.txt model.txt]\n");
+		return -1;
+	}
+	int idleLabel=atoi(argv[2]);
+	double fraction=0.8;
+	char* testPath=NULL;
+	char* modelPath=NULL;
+	char* outputPath=NULL;
+	for(int i=3;i<argc;i++)
+	{
+		if(i+1<argc && strcmp(argv[i],"-m")==0)
+		{
+			fraction=atof(argv[++i]);
+		}
+		else if(i+1<argc && strcmp(argv[i],"-o")==0)
+		{
+			outputPath=argv[++i];
+		}
+		else if(i+2<argc && strcmp(argv[i],"-t")==0)
+		{
+			testPath=argv[++i];
+			modelPath=argv[++i];
+		}
+		else
+		{
+			printf("Unknown option %s\n",argv[i]);
+			return -1;
+		}
+	}
+	std::vector<Sample> samples;
+	if(!ReadSamples(argv[1],samples))
+	{
+		return -1;
+	}
+
+	// the energy of every sample, by class
+	std::map<int, std::vector<double> > energies;
+	GestureRecognizer recognizer;
+	for(size_t n=0;n<samples.size();n++)
+	{
+		Replay(recognizer,samples[n]);
+		energies[samples[n].label].push_back(recognizer.GetMotionEnergy());
+	}
+	double lowestGesture=-1.0;
+	printf("Motion energy (mm per frame) of %d samples:\n",(int)samples.size());
+	for(std::map<int, std::vector<double> >::iterator it=energies.begin();it!=energies.end();++it)
+	{
+		std::vector<double>& values=it->second;
+		std::sort(values.begin(),values.end());
+		printf("  class %d%s: %d samples, lowest %.1f, median %.1f, highest %.1f\n",it->first,it->first==idleLabel ? " (idle)" : "",
+				(int)values.size(),values.front(),values[values.size()/2],values.back());
+		if(it->first!=idleLabel && (lowestGesture<0.0 || values.front()<lowestGesture))
+		{
+			lowestGesture=values.front();
+		}
+	}
+	if(lowestGesture<0.0)
+	{
+		printf("No gesture samples to learn from\n");
+		return -1;
+	}
+	double threshold=fraction*lowestGesture;
+	const std::vector<double>& idle=energies[idleLabel];
+	int idleBelow=(int)(std::lower_bound(idle.begin(),idle.end(),threshold)-idle.begin());
+	printf("Threshold: %.2f (%.2f of the lowest gesture), %d of %d idle samples below it\n",threshold,fraction,
+			idleBelow,(int)idle.size());
+	if(outputPath!=NULL)
+	{
+		if(!GestureRecognizer::SaveIdleGate(outputPath,threshold,idleLabel))
+		{
+			return -1;
+		}
+		printf("Idle gate written to %s\n",outputPath);
+	}
+	if(testPath==NULL)
+	{
+		return 0;
+	}
+
+	std::vector<Sample> tests;
+	if(!ReadSamples(testPath,tests))
+	{
+		return -1;
+	}
+	std::vector<int> backgrounds;
+	for(size_t n=0;n<tests.size();n++)
+	{
+		if(tests[n].label==idleLabel)
+		{
+			backgrounds.push_back((int)n);
+		}
+	}
+	GestureRecognizer classifier(modelPath);
+	for(int gated=0;gated<2;gated++)
+	{
+		classifier.SetIdleGate(gated ? threshold : 0.0,idleLabel);
+		GesturePredictionStats before=classifier.GetPredictionStats();
+		int correct=0;
+		int idleSkipped=0, idleSamples=0, gestureSkipped=0;
+		long frames=0;
+		double seconds=0.0;
+		int nextBackground=0;
+		for(size_t n=0;n<tests.size();n++)
+		{
+			const Sample* leadIn=NULL;
+			for(size_t tries=0;tries<backgrounds.size() && leadIn==NULL;tries++)
+			{
+				int b=backgrounds[nextBackground++%backgrounds.size()];
+				if(b!=(int)n)
+				{
+					leadIn=&tests[b];
+				}
+			}
+			clock_t start=clock();
+			if(leadIn!=NULL)
+			{
+				Replay(classifier,*leadIn);
+				frames+=GestureRecognizer::WINDOW_FRAMES;
+			}
+			Replay(classifier,tests[n]);
+			frames+=GestureRecognizer::WINDOW_FRAMES;
+			seconds+=(clock()-start)/(double)CLOCKS_PER_SEC;
+			if(classifier.GetGesture()==tests[n].label)
+			{
+				correct++;
+			}
+			// would the window of just this sample skip the model
+			if(tests[n].label==idleLabel)
+			{
+				idleSamples++;
+				idleSkipped+=classifier.IsIdle() ? 1 : 0;
+			}
+			else
+			{
+				gestureSkipped+=classifier.IsIdle() ? 1 : 0;
+			}
+		}
+		GesturePredictionStats after=classifier.GetPredictionStats();
+		XnUInt64 predictions=after.predictions-before.predictions;
+		printf("%s: %.1f%% correct, %.1f%% of predictions skipped the model, %.1f us per frame\n",gated ? "Gated" : "Ungated",
+				100.0*correct/tests.size(),predictions>0 ? 100.0*(after.idle-before.idle)/predictions : 0.0,1e6*seconds/frames);
+		if(gated)
+		{
+			printf("Windows of one sample skipped: %d of %d idle, %d of %d gestures\n",idleSkipped,idleSamples,
+					gestureSkipped,(int)tests.size()-idleSamples);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+/************************************************
+ * PartialWindows.cpp
+ * 
+ * Makes the training data for EarlyDetector from an existing LIBSVM file
+ * of full window samples (GestureRecognizer's layout). For every window
+ * length N, each sample is cut down to its first N frames, the start of the
+ * gesture, and those features are renumbered to the last N frames of the
+ * window. That is where the recognizer has the first N frames of a gesture
+ * N frames after it starts, so the partial models are evaluated in place on
+ * the live window.
+ * 
+ * Only the newest frame of a window has all 18 features (see
+ * GestureRecognizer.h), so a slice that moves to the end of the window has
+ * no value for the last feature. The support vectors are 0 there, which
+ * the polynomial kernel ignores.
+ * 
+ * The detector runs on every frame, so it also sees the middle and end of
+ * gestures. With -s, later N frame slices of each sample, every <stride>
+ * frames, are written with the sample's label as well.
+ * 
+ * Train each output with svm-train as usual (-b 1 for probability
+ * confidences) and give the models to EarlyDetector::AddStage.
+ * 
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * 
+ * Usage: ./PartialWindows <samples.txt> <outputPrefix> [-s stride] [frames...]
+ *   Writes <outputPrefix>.<frames>.txt for each window length
+ *   (default 15 30 45)
+ * ********************************************/
+
+#include "SampleReader.h"
+#include "SampleWriter.h"
+#include "GestureRecognizer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+	if(argc<3)
+	{
+		printf("Missing arguments\nUsage: ./PartialWindows <samples.txt> <outputPrefix> [-s stride] [frames...]\n");
+		return -1;
+	}
+	std::vector<int> lengths;
+	int stride=0;
+	for(int i=3;i<argc;i++)
+	{
+		if(strcmp(argv[i],"-s")==0 && i+1<argc)
+		{
+			stride=atoi(argv[++i]);
+			continue;
+		}
+		int frames=atoi(argv[i]);
+		if(frames<1 || frames>GestureRecognizer::FRAMES)
+		{
+			printf("Window length must be 1 to %d frames\n",GestureRecognizer::FRAMES);
+			return -1;
+		}
+		lengths.push_back(frames);
+	}
+	if(lengths.empty())
+	{
+		lengths.push_back(15);
+		lengths.push_back(30);
+		lengths.push_back(45);
+	}
+
+	SampleReader input;
+	if(!input.Open(argv[1]))
+	{
+		return -1;
+	}
+	std::vector<struct svm_node> sample;
+	std::vector<struct svm_node> partial;
+	int label;
+	for(size_t n=0;n<lengths.size();n++)
+	{
+		char path[1024];
+		snprintf(path,sizeof(path),"%s.%d.txt",argv[2],lengths[n]);
+		SampleWriter output;
+		if(!output.Open(path))
+		{
+			return -1;
+		}
+		int samples=0;
+		input.Rewind();
+		while(input.Read(label,sample))
+		{
+			// slices by how many frames before the newest they end, the
+			// first one is the start of the gesture
+			for(int back=GestureRecognizer::FRAMES-lengths[n];back>=0;back-=(stride>0 ? stride : back+1))
+			{
+				int first=GestureRecognizer::FrameOffset(back+lengths[n]-1);
+				int last=GestureRecognizer::FrameOffset(back)+GestureRecognizer::FrameLength(back);
+				partial.clear();
+				for(size_t i=0;sample[i].index!=-1;i++)
+				{
+					if(sample[i].index>first && sample[i].index<=last)
+					{
+						struct svm_node node=sample[i];
+						node.index+=back*GestureRecognizer::SHIFT;
+						partial.push_back(node);
+					}
+				}
+				struct svm_node end;
+				end.index=-1;
+				end.value=0.0;
+				partial.push_back(end);
+				output.WriteSample(label,&partial[0]);
+				samples++;
+			}
+		}
+		output.Close();
+		printf("%s: %d samples of %d frames\n",path,samples,lengths[n]);
+	}
+	return 0;
+}
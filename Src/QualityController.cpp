@@ -0,0 +1,136 @@
+/******************************************************************************
+ * QualityController.cpp
+ *
+ * Steps the quality level down and up to keep frames inside their budget.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "QualityController.h"
+#include <string.h>
+
+/**
+ * Constructor
+ * @param budgetMs how long a frame may take to process
+ * @param numLevels quality levels including full quality, at most
+ * QUALITY_MAX_LEVELS
+ */
+QualityController::QualityController(double budgetMs, int numLevels)
+{
+	this->budgetMs = budgetMs;
+	this->numLevels = QUALITY_MAX_LEVELS;
+	Reset();
+	SetNumLevels(numLevels);
+}
+
+/**
+ * Change the budget, keeps the level
+ */
+void QualityController::SetBudget(double budgetMs)
+{
+	this->budgetMs = budgetMs;
+	stats.budgetMs = budgetMs;
+}
+
+double QualityController::GetBudget() const
+{
+	return budgetMs;
+}
+
+/**
+ * How many levels there are to step through, the level is capped to them
+ */
+void QualityController::SetNumLevels(int numLevels)
+{
+	this->numLevels = numLevels<1 ? 1 : (numLevels>QUALITY_MAX_LEVELS ? QUALITY_MAX_LEVELS : numLevels);
+	if(stats.level>=this->numLevels)
+	{
+		stats.level = this->numLevels-1;
+	}
+}
+
+/**
+ * Back to full quality and no measurements
+ */
+void QualityController::Reset()
+{
+	memset(&stats,0,sizeof(stats));
+	stats.budgetMs = budgetMs;
+	averageMs = 0.0;
+	framesSinceChange = 0;
+	framesWithHeadroom = 0;
+}
+
+/**
+ * Take how long the latest frame took
+ * @param frameNs processing time of the frame in nanoseconds
+ * @return true if the level changed
+ */
+bool QualityController::Update(XnUInt64 frameNs)
+{
+	double ms = frameNs/1e6;
+	// about the last 8 frames
+	averageMs = stats.frames==0 ? ms : averageMs+(ms-averageMs)/8.0;
+	stats.frames++;
+	stats.framesAtLevel[stats.level]++;
+	if(ms>budgetMs)
+	{
+		stats.framesOverBudget++;
+	}
+	if(ms>stats.maxMs)
+	{
+		stats.maxMs = ms;
+	}
+	stats.averageMs = averageMs;
+
+	framesWithHeadroom = averageMs<budgetMs*QUALITY_RESTORE_FRACTION ? framesWithHeadroom+1 : 0;
+	if(++framesSinceChange<QUALITY_SETTLE_FRAMES)
+	{
+		return false;
+	}
+	if(averageMs>budgetMs*QUALITY_DEGRADE_FRACTION && stats.level<numLevels-1)
+	{
+		stats.level++;
+		stats.degrades++;
+	}
+	else if(framesWithHeadroom>=QUALITY_RESTORE_FRAMES && stats.level>0)
+	{
+		stats.level--;
+		stats.restores++;
+	}
+	else
+	{
+		return false;
+	}
+	framesSinceChange = 0;
+	framesWithHeadroom = 0;
+	return true;
+}
+
+/**
+ * The current level, 0 is full quality
+ */
+int QualityController::GetLevel() const
+{
+	return stats.level;
+}
+
+QualityStats QualityController::GetStats() const
+{
+	return stats;
+}
+
+/**
+ * Print the level and what it took to get there
+ */
+void QualityController::PrintStats(FILE* file) const
+{
+	fprintf(file,"Quality level %d of %d, budget %.1f ms: %llu frames, %llu over budget, %llu degrades, %llu restores\n",
+			stats.level,numLevels-1,budgetMs,(unsigned long long)stats.frames,(unsigned long long)stats.framesOverBudget,
+			(unsigned long long)stats.degrades,(unsigned long long)stats.restores);
+	fprintf(file,"  frame time  smoothed %7.2f ms  max %7.2f ms\n",stats.averageMs,stats.maxMs);
+	for(int i=0;i<numLevels;i++)
+	{
+		fprintf(file,"  level %d     %llu frames\n",i,(unsigned long long)stats.framesAtLevel[i]);
+	}
+}
@@ -0,0 +1,68 @@
+/*************************************************
+ * QualityController.h
+ *
+ * Keeps the recognition loop inside its frame budget. Fed how long each
+ * frame took to process, it steps down a ladder of quality levels while
+ * the frames run over budget, and back up once they have had headroom for
+ * a while. What each level gives up is up to the owner (UserTracking
+ * classifies less often and fewer users), the controller only decides the
+ * level.
+ *
+ * The frame time is smoothed so a single slow frame doesn't change the
+ * level, and a level is held for a while after every change so the
+ * smoothed time can catch up with it. Restoring takes longer than
+ * degrading: falling behind the sensor costs more than a few frames at
+ * lower quality.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef QUALITY_CONTROLLER_H
+#define QUALITY_CONTROLLER_H
+
+#include <XnOpenNI.h>
+#include <stdio.h>
+
+#define QUALITY_MAX_LEVELS 8
+#define QUALITY_DEFAULT_BUDGET_MS 33.3 // a frame at 30 Hz
+#define QUALITY_DEGRADE_FRACTION 0.9 // of the budget the smoothed time may reach
+#define QUALITY_RESTORE_FRACTION 0.5 // of the budget it must stay under to restore
+#define QUALITY_SETTLE_FRAMES 15 // frames a level is held after a change
+#define QUALITY_RESTORE_FRAMES 90 // frames of headroom before restoring, 3 s at 30 Hz
+
+struct QualityStats
+{
+	int level; // 0 is full quality
+	XnUInt64 frames; // frames measured
+	XnUInt64 framesOverBudget;
+	XnUInt64 degrades; // level changes down and up
+	XnUInt64 restores;
+	XnUInt64 framesAtLevel[QUALITY_MAX_LEVELS];
+	double averageMs; // smoothed frame time
+	double maxMs;
+	double budgetMs;
+};
+
+class QualityController
+{
+private:
+	double budgetMs;
+	int numLevels;
+	double averageMs;
+	int framesSinceChange;
+	int framesWithHeadroom; // in a row
+	QualityStats stats;
+
+public:
+	QualityController(double budgetMs = QUALITY_DEFAULT_BUDGET_MS, int numLevels = QUALITY_MAX_LEVELS);
+	void SetBudget(double budgetMs);
+	double GetBudget() const;
+	void SetNumLevels(int numLevels);
+	bool Update(XnUInt64 frameNs);
+	void Reset();
+	int GetLevel() const;
+	QualityStats GetStats() const;
+	void PrintStats(FILE* file) const;
+};
+
+#endif
@@ -0,0 +1,124 @@
+/************************************************
+ * ReplayTest.cpp
+ *
+ * Checks that ReplaySkeletonSource splits a skeleton log into the frames
+ * that were logged. KinectRecording writes its sample markers late, from
+ * the recognition thread and with the sequence number of an older frame,
+ * so the log written here has markers landing between and inside later
+ * frames. Replay must skip them: no frame without users, no frame out of
+ * order and no user lost.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ *
+ * Usage: ./ReplayTest [scratch.skl]
+ *   Returns 0 when every check passes
+ * ********************************************/
+
+#include "SkeletonLog.h"
+#include "SkeletonSource.h"
+#include <string.h>
+
+#define TEST_FRAMES 4
+#define TEST_USERS 2
+#define TEST_FRAME_US 33333
+
+/**
+ * One joint record of a user in a frame, every joint at a known position
+ */
+static SkeletonLogRecord JointRecord(XnUInt32 sequence, XnUserID userId)
+{
+	SkeletonLogRecord record;
+	memset(&record,0,sizeof(record));
+	record.timestamp=1000000+sequence*TEST_FRAME_US;
+	record.frameId=100+sequence;
+	record.sequence=sequence;
+	record.userId=userId;
+	record.type=SKELETON_LOG_JOINTS;
+	for(int j=0;j<SKELETON_LOG_NUM_JOINTS;j++)
+	{
+		record.confidence[j]=255;
+		record.position[j][0]=(float)(sequence*100+userId);
+		record.position[j][1]=(float)j;
+		record.position[j][2]=2000.0f;
+	}
+	return record;
+}
+
+/**
+ * Writes TEST_FRAMES frames of TEST_USERS users with a marker for frame 0
+ * in the middle of frame 2 and one for frame 1 after the last frame
+ */
+static bool WriteLog(const char* path)
+{
+	SkeletonLogWriter log;
+	if(!log.Open(path))
+	{
+		return false;
+	}
+	for(XnUInt32 sequence=0;sequence<TEST_FRAMES;sequence++)
+	{
+		for(XnUserID userId=1;userId<=TEST_USERS;userId++)
+		{
+			SkeletonLogRecord record=JointRecord(sequence,userId);
+			log.Write(&record,1);
+			if(sequence==2 && userId==1)
+			{
+				SkeletonFrame old;
+				old.timestamp=JointRecord(0,1).timestamp;
+				old.frameId=100;
+				old.sequence=0;
+				log.WriteSample(old,1,3);
+			}
+		}
+	}
+	SkeletonFrame old;
+	old.timestamp=JointRecord(1,2).timestamp;
+	old.frameId=101;
+	old.sequence=1;
+	log.WriteSample(old,2,4);
+	log.Close();
+	return true;
+}
+
+static int failures=0;
+
+static void Check(bool ok, const char* what, int frame)
+{
+	if(!ok)
+	{
+		printf("FAIL frame %d: %s\n",frame,what);
+		failures++;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const char* path = argc>1 ? argv[1] : "ReplayTest.skl";
+	if(!WriteLog(path))
+	{
+		return -1;
+	}
+	ReplaySkeletonSource source(false);
+	if(!source.Open(path))
+	{
+		return -1;
+	}
+	SkeletonFrame frame;
+	int frames=0;
+	while(source.NextFrame(frame)==XN_STATUS_OK)
+	{
+		Check(frames<TEST_FRAMES,"more frames than were logged",frames);
+		Check(frame.sequence==(XnUInt32)frames,"wrong sequence",frames);
+		Check(frame.timestamp==JointRecord(frames,1).timestamp,"wrong timestamp",frames);
+		Check(frame.nUsers==TEST_USERS,"wrong number of users",frames);
+		for(int i=0;i<frame.nUsers && i<TEST_USERS;i++)
+		{
+			Check(frame.users[i].id==(XnUserID)(i+1),"wrong user",frames);
+			Check(frame.users[i].x[SKELETON_TORSO]==(float)(frames*100+i+1),"joints from another frame",frames);
+		}
+		frames++;
+	}
+	Check(frames==TEST_FRAMES,"frames missing",frames);
+	remove(path);
+	printf("%s: %d frames replayed, %d failures\n",failures==0 ? "PASS" : "FAIL",frames,failures);
+	return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+/******************************************************************************
+ * SampleReader.cpp
+ *
+ * Reads LIBSVM samples.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "SampleReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+/**
+ * Constructor
+ */
+SampleReader::SampleReader()
+	: line(1024)
+{
+	file=NULL;
+	lineNumber=0;
+}
+
+/**
+ * Destructor
+ */
+SampleReader::~SampleReader()
+{
+	Close();
+}
+
+/**
+ * Open a LIBSVM file for reading
+ */
+bool SampleReader::Open(const char* path)
+{
+	Close();
+	file=fopen(path,"r");
+	if(file==NULL)
+	{
+		printf("Could not open %s\n",path);
+		return false;
+	}
+	lineNumber=0;
+	return true;
+}
+
+void SampleReader::Close()
+{
+	if(file!=NULL)
+	{
+		fclose(file);
+		file=NULL;
+	}
+}
+
+/**
+ * Start again from the first sample
+ */
+void SampleReader::Rewind()
+{
+	if(file!=NULL)
+	{
+		rewind(file);
+		lineNumber=0;
+	}
+}
+
+/**
+ * Read the next line, however long, into line
+ */
+bool SampleReader::ReadLine()
+{
+	size_t length=0;
+	while(fgets(&line[length],(int)(line.size()-length),file)!=NULL)
+	{
+		length+=strlen(&line[length]);
+		if(line[length-1]=='\n' || feof(file))
+		{
+			break;
+		}
+		line.resize(line.size()*2);
+	}
+	if(length==0)
+	{
+		return false;
+	}
+	lineNumber++;
+	return true;
+}
+
+/**
+ * Read the next sample, skipping blank lines
+ * @param features set to the sample's nodes, terminated by a node with
+ * index -1
+ * @return false at the end of the file or on a malformed line
+ */
+bool SampleReader::Read(int& classLabel, std::vector<struct svm_node>& features)
+{
+	if(file==NULL)
+	{
+		return false;
+	}
+	char* text;
+	char* end;
+	do
+	{
+		if(!ReadLine())
+		{
+			return false;
+		}
+		text=&line[0];
+		classLabel=(int)strtol(text,&end,10);
+	} while(end==text && strspn(text," \t\r\n")==strlen(text));
+	if(end==text)
+	{
+		printf("Line %ld: missing class label\n",lineNumber);
+		return false;
+	}
+	features.clear();
+	struct svm_node node;
+	text=end;
+	while(true)
+	{
+		node.index=(int)strtol(text,&end,10);
+		if(end==text)
+		{
+			break;
+		}
+		if(*end!=':')
+		{
+			printf("Line %ld: expected index:value\n",lineNumber);
+			return false;
+		}
+		text=end+1;
+		node.value=strtod(text,&end);
+		if(end==text)
+		{
+			printf("Line %ld: expected index:value\n",lineNumber);
+			return false;
+		}
+		text=end;
+		features.push_back(node);
+	}
+	node.index=-1;
+	node.value=0.0;
+	features.push_back(node);
+	return true;
+}
+
+/**
+ * Read the next sample as dense values, skipping blank lines
+ * @param values its size is the number of features kept, feature i is
+ * values[i-1] and features the sample leaves out are 0
+ * @return false at the end of the file or on a malformed line
+ */
+bool SampleReader::Read(int& classLabel, std::vector<double>& values)
+{
+	if(!Read(classLabel,nodes))
+	{
+		return false;
+	}
+	std::fill(values.begin(),values.end(),0.0);
+	for(size_t i=0;nodes[i].index!=-1;i++)
+	{
+		if(nodes[i].index>=1 && nodes[i].index<=(int)values.size())
+		{
+			values[nodes[i].index-1]=nodes[i].value;
+		}
+	}
+	return true;
+}
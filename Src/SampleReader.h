@@ -0,0 +1,41 @@
+/*************************************************
+ * SampleReader.h
+ *
+ * Streams samples out of a LIBSVM file, such as one written by
+ * KinectRecording or LogToFeatures, for the tools that work on existing
+ * training data.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef SAMPLE_READER_H
+#define SAMPLE_READER_H
+
+#include "svm.h"
+#include <stdio.h>
+#include <vector>
+
+class SampleReader
+{
+private:
+	FILE* file;
+	std::vector<char> line;
+	long lineNumber;
+	std::vector<struct svm_node> nodes; // for reading dense samples
+
+	bool ReadLine();
+
+public:
+	SampleReader();
+	~SampleReader();
+	SampleReader(const SampleReader& other) = delete;
+	SampleReader& operator=(const SampleReader& other) = delete;
+
+	bool Open(const char* path);
+	void Close();
+	bool Read(int& classLabel, std::vector<struct svm_node>& features);
+	bool Read(int& classLabel, std::vector<double>& values);
+	void Rewind();
+};
+
+#endif
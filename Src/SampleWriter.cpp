@@ -0,0 +1,125 @@
+/******************************************************************************
+ * SampleWriter.cpp
+ *
+ * Background LIBSVM sample writer.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "SampleWriter.h"
+#include "GestureRecognizer.h"
+#include <string.h>
+
+/**
+ * How a sample is laid out in the queue, followed by count svm_nodes
+ */
+struct QueuedSample
+{
+	int classLabel;
+	int count;
+};
+
+/**
+ * Constructor
+ */
+SampleWriter::SampleWriter()
+{
+	samplesQueued=0;
+	samplesWritten=0;
+}
+
+/**
+ * Destructor, formats and writes anything still queued
+ */
+SampleWriter::~SampleWriter()
+{
+	Close();
+}
+
+/**
+ * Create (truncate) a LIBSVM file
+ */
+bool SampleWriter::Open(const char* path)
+{
+	samplesQueued=0;
+	samplesWritten=0;
+	return BackgroundWriter::Open(path,"w");
+}
+
+/**
+ * Queue a sample (e.g. GestureRecognizer::GetFeatures()). Only copies the
+ * nodes, formatting happens on the writer thread.
+ * @param features terminated by a node with index -1
+ */
+void SampleWriter::WriteSample(int classLabel, const struct svm_node* features)
+{
+	QueuedSample header;
+	header.classLabel=classLabel;
+	header.count=0;
+	while(features[header.count].index!=-1)
+	{
+		header.count++;
+	}
+	samplesQueued++;
+	// include the terminating node so the writer thread can format it as is
+	Write(&header,sizeof(header),features,(header.count+1)*sizeof(struct svm_node));
+}
+
+/**
+ * Formats a batch of queued samples and writes them, on the writer thread
+ */
+size_t SampleWriter::WriteBatch(const char* data, size_t size, FILE* file)
+{
+	size_t written = 0;
+	size_t offset = 0;
+	while(offset+sizeof(QueuedSample)<=size)
+	{
+		QueuedSample header;
+		memcpy(&header,data+offset,sizeof(header));
+		offset+=sizeof(header);
+		// copy out since the batch gives no alignment guarantee
+		features.resize(header.count+1);
+		memcpy(&features[0],data+offset,(header.count+1)*sizeof(struct svm_node));
+		offset+=(header.count+1)*sizeof(struct svm_node);
+		if(text.size()<(size_t)header.count*24+32)
+		{
+			text.resize(header.count*24+32);
+		}
+		char* end;
+		while((end=GestureRecognizer::FormatFeatures(&text[0],&text[0]+text.size(),header.classLabel,&features[0]))==NULL)
+		{
+			text.resize(text.size()*2);
+		}
+		written+=fwrite(&text[0],1,end-&text[0],file);
+		samplesWritten++;
+	}
+	return written;
+}
+
+/**
+ * Number of samples formatted and written so far
+ */
+unsigned long long SampleWriter::GetSamplesWritten() const
+{
+	return samplesWritten;
+}
+
+/**
+ * Number of samples queued but not written yet
+ */
+int SampleWriter::GetQueueDepth() const
+{
+	return (int)(samplesQueued-samplesWritten);
+}
+
+/**
+ * Prints throughput and queue depth
+ */
+void SampleWriter::PrintStats(FILE* file) const
+{
+	BackgroundWriterStats stats = GetStats();
+	double samplesPerSecond = stats.busySeconds>0 ? samplesWritten/stats.busySeconds : 0.0;
+	fprintf(file,"Samples written: %llu (%.2f MB), queue depth %d, max queued %.1f KB\n",
+			(unsigned long long)samplesWritten,stats.bytesWritten/1000000.0,GetQueueDepth(),stats.maxPendingBytes/1000.0);
+	fprintf(file,"  writer busy %.3f s: %.1f samples/s, %.2f MB/s\n",stats.busySeconds,samplesPerSecond,stats.MegabytesPerSecond());
+}
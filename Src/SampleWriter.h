@@ -0,0 +1,42 @@
+/*************************************************
+ * SampleWriter.h
+ *
+ * Writes LIBSVM samples from a background thread. WriteSample only copies
+ * the label and feature values into the front buffer; turning them into
+ * text (with std::to_chars) and writing the file both happen on the writer
+ * thread, so the recording loop never waits on either.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef SAMPLE_WRITER_H
+#define SAMPLE_WRITER_H
+
+#include "BackgroundWriter.h"
+#include "svm.h"
+#include <atomic>
+#include <vector>
+
+class SampleWriter : public BackgroundWriter
+{
+private:
+	std::vector<char> text; // formatting buffer, only used by the writer thread
+	std::vector<struct svm_node> features; // only used by the writer thread
+	std::atomic<unsigned long long> samplesQueued;
+	std::atomic<unsigned long long> samplesWritten;
+
+protected:
+	size_t WriteBatch(const char* data, size_t size, FILE* file);
+
+public:
+	SampleWriter();
+	~SampleWriter();
+
+	bool Open(const char* path);
+	void WriteSample(int classLabel, const struct svm_node* features);
+	unsigned long long GetSamplesWritten() const;
+	int GetQueueDepth() const;
+	void PrintStats(FILE* file) const;
+};
+
+#endif
@@ -0,0 +1,132 @@
+/******************************************************************************
+ * SkeletonFrame.cpp
+ *
+ * Reads the joints of every tracked user from OpenNI into a SkeletonFrame.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "SkeletonFrame.h"
+#include <stdio.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+const XnSkeletonJoint SKELETON_JOINT_IDS[SKELETON_NUM_JOINTS] =
+{
+	XN_SKEL_TORSO,
+	XN_SKEL_LEFT_SHOULDER,
+	XN_SKEL_LEFT_ELBOW,
+	XN_SKEL_LEFT_HAND,
+	XN_SKEL_RIGHT_SHOULDER,
+	XN_SKEL_RIGHT_ELBOW,
+	XN_SKEL_RIGHT_HAND,
+	XN_SKEL_HEAD,
+	XN_SKEL_NECK,
+	XN_SKEL_LEFT_HIP,
+	XN_SKEL_LEFT_KNEE,
+	XN_SKEL_LEFT_FOOT,
+	XN_SKEL_RIGHT_HIP,
+	XN_SKEL_RIGHT_KNEE,
+	XN_SKEL_RIGHT_FOOT,
+};
+
+/**
+ * Reads the joints of one user straight into the skeleton's joint arrays.
+ * OpenNI has no call for several joints at once, so only the joints asked
+ * for are read; the rest are 0 and left out of validJoints, as is a joint
+ * that can't be read.
+ * @param joints bit per SkeletonJoint to read
+ */
+void FetchUserSkeleton(xn::SkeletonCapability& skeleton, XnUserID id, UserSkeleton& user, XnUInt32 joints)
+{
+	XnSkeletonJointPosition joint;
+	user.id = id;
+	user.validJoints = 0;
+	for(int j=0;j<SKELETON_NUM_JOINTS;j++)
+	{
+		if(!(joints & (1u<<j)))
+		{
+			user.x[j] = user.y[j] = user.z[j] = 0.0f;
+			continue;
+		}
+		XnStatus nRetVal = skeleton.GetSkeletonJointPosition(id, SKELETON_JOINT_IDS[j], joint);
+		if(nRetVal != XN_STATUS_OK)
+		{
+			joint.position.X = joint.position.Y = joint.position.Z = 0;
+			joint.fConfidence = 0;
+		}
+		user.x[j] = joint.position.X;
+		user.y[j] = joint.position.Y;
+		user.z[j] = joint.position.Z;
+		if(joint.fConfidence>=SKELETON_MIN_CONFIDENCE)
+		{
+			user.validJoints |= 1<<j;
+		}
+	}
+	for(int j=SKELETON_NUM_JOINTS;j<SKELETON_JOINT_LANES;j++)
+	{
+		user.x[j] = user.y[j] = user.z[j] = 0.0f;
+	}
+}
+
+/**
+ * Fills frame with the joints of every user OpenNI is currently tracking.
+ * Does not wait for new data, call after the context has been updated.
+ * Joints below SKELETON_MIN_CONFIDENCE are read anyway but left out of
+ * validJoints. The frame's sequence is left to the caller.
+ * @param joints bit per SkeletonJoint to read, the rest are left at 0
+ */
+XnStatus FetchSkeletonFrame(xn::UserGenerator& userGenerator, SkeletonFrame& frame, XnUInt32 joints)
+{
+	XnUserID aUsers[SKELETON_MAX_USERS];
+	XnUInt16 nUsers = SKELETON_MAX_USERS;
+
+	XnStatus nRetVal = userGenerator.GetUsers(aUsers, nUsers);
+	if(nRetVal != XN_STATUS_OK)
+	{
+		printf("GetUsers failed: %s\n", xnGetStatusString(nRetVal));
+		return nRetVal;
+	}
+	frame.timestamp = userGenerator.GetTimestamp();
+	frame.frameId = userGenerator.GetFrameID();
+	frame.nUsers = 0;
+	xn::SkeletonCapability skeleton = userGenerator.GetSkeletonCap();
+	for(int i=0;i<nUsers;i++)
+	{
+		if(!skeleton.IsTracking(aUsers[i]))
+		{
+			continue;
+		}
+		FetchUserSkeleton(skeleton, aUsers[i], frame.users[frame.nUsers++], joints);
+	}
+	return XN_STATUS_OK;
+}
+
+/**
+ * Every joint relative to the torso, the torso itself becomes 0.
+ * One subtraction per axis for each group of four joints.
+ */
+void RelativeToTorso(const UserSkeleton& skeleton, UserSkeleton& relative)
+{
+	const float* in[3] = {skeleton.x,skeleton.y,skeleton.z};
+	float* out[3] = {relative.x,relative.y,relative.z};
+	for(int axis=0;axis<3;axis++)
+	{
+#ifdef __SSE__
+		__m128 torso = _mm_set1_ps(in[axis][SKELETON_TORSO]);
+		for(int j=0;j<SKELETON_JOINT_LANES;j+=4)
+		{
+			_mm_store_ps(out[axis]+j,_mm_sub_ps(_mm_load_ps(in[axis]+j),torso));
+		}
+#else
+		float torso = in[axis][SKELETON_TORSO];
+		for(int j=0;j<SKELETON_JOINT_LANES;j++)
+		{
+			out[axis][j] = in[axis][j]-torso;
+		}
+#endif
+	}
+	relative.id = skeleton.id;
+	relative.validJoints = skeleton.validJoints;
+}
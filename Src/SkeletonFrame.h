@@ -0,0 +1,107 @@
+/*************************************************
+ * SkeletonFrame.h
+ *
+ * A snapshot of every tracked user's joints for one sensor frame. This is
+ * what gets handed from the capture side of the program to the recognition
+ * side, so it is a plain fixed size struct that can be copied into a queue.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef SKELETON_FRAME_H
+#define SKELETON_FRAME_H
+
+#include <XnOpenNI.h>
+#include <XnCppWrapper.h>
+
+#define SKELETON_MAX_USERS 15
+
+/**
+ * Bits of UserSkeleton::validJoints, in the order the joints are stored.
+ * The torso and arms come first, they are what the default recognizer uses
+ * and all that is read from OpenNI unless more joints are asked for.
+ */
+enum SkeletonJoint
+{
+	SKELETON_TORSO,
+	SKELETON_LEFT_SHOULDER,
+	SKELETON_LEFT_ELBOW,
+	SKELETON_LEFT_HAND,
+	SKELETON_RIGHT_SHOULDER,
+	SKELETON_RIGHT_ELBOW,
+	SKELETON_RIGHT_HAND,
+	SKELETON_HEAD,
+	SKELETON_NECK,
+	SKELETON_LEFT_HIP,
+	SKELETON_LEFT_KNEE,
+	SKELETON_LEFT_FOOT,
+	SKELETON_RIGHT_HIP,
+	SKELETON_RIGHT_KNEE,
+	SKELETON_RIGHT_FOOT,
+	SKELETON_NUM_JOINTS
+};
+#define SKELETON_ALL_JOINTS ((1<<SKELETON_NUM_JOINTS)-1)
+#define SKELETON_ARM_JOINTS ((1<<(SKELETON_RIGHT_HAND+1))-1) // torso and both arms
+/**
+ * OpenNI reports 0 for a joint it lost, 0.5 for a guessed one and 1 for a
+ * tracked one. Guesses are still usable.
+ */
+#define SKELETON_MIN_CONFIDENCE 0.5f
+
+/**
+ * SKELETON_NUM_JOINTS rounded up to whole 4 float SIMD vectors
+ */
+#define SKELETON_JOINT_LANES 16
+
+/**
+ * The joints used for recognition for one user, in sensor coordinates.
+ *
+ * Stored as one array per axis indexed by SkeletonJoint rather than one
+ * XnVector3D per joint, so an operation on every joint (normalizing to the
+ * torso, interpolating) is a couple of SIMD instructions per axis. The lanes
+ * past SKELETON_NUM_JOINTS are padding.
+ */
+struct alignas(16) UserSkeleton
+{
+	float x[SKELETON_JOINT_LANES];
+	float y[SKELETON_JOINT_LANES];
+	float z[SKELETON_JOINT_LANES];
+	XnUserID id;
+	XnUInt32 validJoints; // bit per SkeletonJoint set when its confidence is at least SKELETON_MIN_CONFIDENCE
+
+	XnVector3D GetJoint(int joint) const
+	{
+		XnVector3D position;
+		position.X = x[joint];
+		position.Y = y[joint];
+		position.Z = z[joint];
+		return position;
+	}
+	void SetJoint(int joint, const XnVector3D& position)
+	{
+		x[joint] = position.X;
+		y[joint] = position.Y;
+		z[joint] = position.Z;
+	}
+};
+
+struct SkeletonFrame
+{
+	XnUInt64 timestamp; // sensor timestamp (microseconds)
+	XnUInt32 frameId; // sensor frame number
+	XnUInt32 sequence; // frame number from the start of the source
+	XnUInt64 captureTime; // host steady clock (nanoseconds) when captured
+	int nUsers;
+	UserSkeleton users[SKELETON_MAX_USERS];
+};
+
+/**
+ * The OpenNI joint for each SkeletonJoint
+ */
+extern const XnSkeletonJoint SKELETON_JOINT_IDS[SKELETON_NUM_JOINTS];
+
+void FetchUserSkeleton(xn::SkeletonCapability& skeleton, XnUserID id, UserSkeleton& user, XnUInt32 joints = SKELETON_ARM_JOINTS);
+XnStatus FetchSkeletonFrame(xn::UserGenerator& userGenerator, SkeletonFrame& frame, XnUInt32 joints = SKELETON_ARM_JOINTS);
+void RelativeToTorso(const UserSkeleton& skeleton, UserSkeleton& relative);
+
+#endif
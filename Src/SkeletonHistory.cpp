@@ -0,0 +1,104 @@
+/******************************************************************************
+ * SkeletonHistory.cpp
+ *
+ * Fixed size ring buffer of skeleton frames.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "SkeletonHistory.h"
+#include <stddef.h>
+
+/**
+ * Constructor, the only allocation the history makes
+ * @param capacity how many frames to keep (30 per second of history)
+ */
+SkeletonHistory::SkeletonHistory(int capacity)
+{
+	this->capacity = capacity>0 ? capacity : 1;
+	frames = new SkeletonFrame[this->capacity];
+	Clear();
+}
+
+/**
+ * Destructor
+ */
+SkeletonHistory::~SkeletonHistory()
+{
+	delete[] frames;
+}
+
+/**
+ * Add the newest frame, overwriting the oldest once full
+ */
+void SkeletonHistory::Push(const SkeletonFrame& frame)
+{
+	newest = (newest+1)%capacity;
+	frames[newest] = frame;
+	if(count<capacity)
+	{
+		count++;
+	}
+}
+
+/**
+ * Forget every frame, keeping the memory
+ */
+void SkeletonHistory::Clear()
+{
+	count = 0;
+	newest = capacity-1;
+}
+
+int SkeletonHistory::Size() const
+{
+	return count;
+}
+
+int SkeletonHistory::Capacity() const
+{
+	return capacity;
+}
+
+/**
+ * @param framesBack 0 for the newest frame, up to Size()-1
+ */
+const SkeletonFrame& SkeletonHistory::FromBack(int framesBack) const
+{
+	return frames[(newest-framesBack+capacity)%capacity];
+}
+
+/**
+ * Collect one user's skeletons for a window of frames, oldest first
+ * @param framesBack how many frames before the newest the window ends
+ * @param length frames in the window
+ * @param window filled with length pointers into the history, valid until
+ * the next Push
+ * @return false if the history doesn't reach that far back or the user is
+ * missing from any frame of the window
+ */
+bool SkeletonHistory::GetUserWindow(XnUserID id, int framesBack, int length, const UserSkeleton** window) const
+{
+	if(framesBack<0 || framesBack+length>count)
+	{
+		return false;
+	}
+	for(int i=0;i<length;i++)
+	{
+		const SkeletonFrame& frame = FromBack(framesBack+length-1-i);
+		window[i] = NULL;
+		for(int j=0;j<frame.nUsers;j++)
+		{
+			if(frame.users[j].id==id)
+			{
+				window[i] = &frame.users[j];
+				break;
+			}
+		}
+		if(window[i]==NULL)
+		{
+			return false;
+		}
+	}
+	return true;
+}
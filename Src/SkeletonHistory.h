@@ -0,0 +1,37 @@
+/*************************************************
+ * SkeletonHistory.h
+ *
+ * A ring buffer of the last few seconds of skeleton frames, allocated once
+ * up front. Pushing a frame copies it over the oldest one, so keeping the
+ * history costs no allocation and a fixed amount of memory. A recording can
+ * then be taken after the fact, from frames that were already captured.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef SKELETON_HISTORY_H
+#define SKELETON_HISTORY_H
+
+#include "SkeletonFrame.h"
+
+class SkeletonHistory
+{
+private:
+	SkeletonFrame* frames;
+	int capacity;
+	int count;
+	int newest; // slot of the most recent frame
+	SkeletonHistory(const SkeletonHistory& other) = delete;
+	SkeletonHistory& operator=(const SkeletonHistory& other) = delete;
+public:
+	SkeletonHistory(int capacity);
+	~SkeletonHistory();
+	void Push(const SkeletonFrame& frame);
+	void Clear();
+	int Size() const;
+	int Capacity() const;
+	const SkeletonFrame& FromBack(int framesBack) const;
+	bool GetUserWindow(XnUserID id, int framesBack, int length, const UserSkeleton** window) const;
+};
+
+#endif
@@ -0,0 +1,345 @@
+/******************************************************************************
+ * SkeletonLog.cpp
+ *
+ * Binary log of raw skeleton data.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "SkeletonLog.h"
+#include <string.h>
+
+static_assert(sizeof(SkeletonLogRecord)==224, "SkeletonLogRecord layout changed");
+static_assert(sizeof(SkeletonLogHeader)==28, "SkeletonLogHeader layout changed");
+
+static const char SKELETON_LOG_MAGIC[4] = {'K','S','K','L'};
+
+const XnSkeletonJoint SKELETON_LOG_JOINT_IDS[SKELETON_LOG_NUM_JOINTS] =
+{
+	XN_SKEL_HEAD, XN_SKEL_NECK, XN_SKEL_TORSO,
+	XN_SKEL_LEFT_SHOULDER, XN_SKEL_LEFT_ELBOW, XN_SKEL_LEFT_HAND,
+	XN_SKEL_RIGHT_SHOULDER, XN_SKEL_RIGHT_ELBOW, XN_SKEL_RIGHT_HAND,
+	XN_SKEL_LEFT_HIP, XN_SKEL_LEFT_KNEE, XN_SKEL_LEFT_FOOT,
+	XN_SKEL_RIGHT_HIP, XN_SKEL_RIGHT_KNEE, XN_SKEL_RIGHT_FOOT,
+};
+
+static const char* SKELETON_LOG_JOINT_NAMES[SKELETON_LOG_NUM_JOINTS] =
+{
+	"head", "neck", "torso",
+	"leftShoulder", "leftElbow", "leftHand",
+	"rightShoulder", "rightElbow", "rightHand",
+	"leftHip", "leftKnee", "leftFoot",
+	"rightHip", "rightKnee", "rightFoot",
+};
+
+/**
+ * Position of an OpenNI joint in a record, -1 if it is not logged
+ */
+int SkeletonLogJointIndex(XnSkeletonJoint joint)
+{
+	for(int i=0;i<SKELETON_LOG_NUM_JOINTS;i++)
+	{
+		if(SKELETON_LOG_JOINT_IDS[i]==joint)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Position of a joint in a record by name (e.g. "leftHand"), -1 if unknown
+ */
+int SkeletonLogJointIndex(const char* name)
+{
+	for(int i=0;i<SKELETON_LOG_NUM_JOINTS;i++)
+	{
+		if(strcmp(SKELETON_LOG_JOINT_NAMES[i],name)==0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Name of the joint at a position in a record
+ */
+const char* SkeletonLogJointName(int index)
+{
+	if(index<0 || index>=SKELETON_LOG_NUM_JOINTS)
+	{
+		return "unknown";
+	}
+	return SKELETON_LOG_JOINT_NAMES[index];
+}
+
+/**
+ * Reads every logged joint of every tracked user into records
+ * @return number of records filled
+ */
+int FetchSkeletonRecords(xn::UserGenerator& userGenerator, XnUInt32 sequence, SkeletonLogRecord* records, int maxRecords)
+{
+	XnSkeletonJointPosition joint;
+	XnUserID aUsers[SKELETON_MAX_USERS];
+	XnUInt16 nUsers = SKELETON_MAX_USERS;
+	if(userGenerator.GetUsers(aUsers, nUsers) != XN_STATUS_OK)
+	{
+		return 0;
+	}
+	XnUInt64 timestamp = userGenerator.GetTimestamp();
+	XnUInt32 frameId = userGenerator.GetFrameID();
+	xn::SkeletonCapability skeleton = userGenerator.GetSkeletonCap();
+	int nRecords = 0;
+	for(int i=0;i<nUsers && nRecords<maxRecords;i++)
+	{
+		if(!skeleton.IsTracking(aUsers[i]))
+		{
+			continue;
+		}
+		SkeletonLogRecord& record = records[nRecords++];
+		memset(&record,0,sizeof(record));
+		record.timestamp=timestamp;
+		record.frameId=frameId;
+		record.sequence=sequence;
+		record.userId=aUsers[i];
+		record.type=SKELETON_LOG_JOINTS;
+		for(int j=0;j<SKELETON_LOG_NUM_JOINTS;j++)
+		{
+			skeleton.GetSkeletonJointPosition(aUsers[i], SKELETON_LOG_JOINT_IDS[j], joint);
+			record.position[j][0]=joint.position.X;
+			record.position[j][1]=joint.position.Y;
+			record.position[j][2]=joint.position.Z;
+			record.confidence[j]=(XnUInt8)(joint.fConfidence*255.0f+0.5f);
+		}
+	}
+	return nRecords;
+}
+
+/**
+ * Copy one joint out of a record
+ */
+static XnVector3D RecordJoint(const SkeletonLogRecord& record, XnSkeletonJoint joint)
+{
+	int index = SkeletonLogJointIndex(joint);
+	XnVector3D position;
+	position.X=record.position[index][0];
+	position.Y=record.position[index][1];
+	position.Z=record.position[index][2];
+	return position;
+}
+
+/**
+ * Builds the recognition frame from the records of one frame. The frame's
+ * timestamp, frameId and sequence are left to the caller since there may
+ * be no records.
+ */
+void SkeletonFrameFromRecords(const SkeletonLogRecord* records, int nRecords, SkeletonFrame& frame)
+{
+	frame.nUsers=0;
+	for(int i=0;i<nRecords && frame.nUsers<SKELETON_MAX_USERS;i++)
+	{
+		const SkeletonLogRecord& record = records[i];
+		if(record.type!=SKELETON_LOG_JOINTS)
+		{
+			continue;
+		}
+		UserSkeleton& user = frame.users[frame.nUsers++];
+		user.id=record.userId;
+		user.validJoints=0;
+		for(int j=0;j<SKELETON_NUM_JOINTS;j++)
+		{
+			user.SetJoint(j,RecordJoint(record,SKELETON_JOINT_IDS[j]));
+			if(record.confidence[SkeletonLogJointIndex(SKELETON_JOINT_IDS[j])]>=(XnUInt8)(SKELETON_MIN_CONFIDENCE*255.0f+0.5f))
+			{
+				user.validJoints|=1<<j;
+			}
+		}
+	}
+}
+
+/**
+ * Create a log and write its header
+ */
+bool SkeletonLogWriter::Open(const char* path)
+{
+	if(!writer.Open(path,"wb"))
+	{
+		return false;
+	}
+	SkeletonLogHeader header;
+	memset(&header,0,sizeof(header));
+	memcpy(header.magic,SKELETON_LOG_MAGIC,4);
+	header.version=SKELETON_LOG_VERSION;
+	header.numJoints=SKELETON_LOG_NUM_JOINTS;
+	for(int i=0;i<SKELETON_LOG_NUM_JOINTS;i++)
+	{
+		header.joints[i]=SKELETON_LOG_JOINT_IDS[i];
+	}
+	header.recordSize=sizeof(SkeletonLogRecord);
+	writer.Write(&header,sizeof(header));
+	return true;
+}
+
+bool SkeletonLogWriter::IsOpen() const
+{
+	return writer.IsOpen();
+}
+
+/**
+ * Queue records for writing, never blocks on the disk
+ */
+void SkeletonLogWriter::Write(const SkeletonLogRecord* records, int nRecords)
+{
+	if(nRecords>0)
+	{
+		writer.Write(records,nRecords*sizeof(SkeletonLogRecord));
+	}
+}
+
+/**
+ * Mark that a labeled sample of a user ended just before a frame
+ * @param frame the first frame after the sample
+ * @param userId the user who performed it
+ * @param label the class label of the sample
+ */
+void SkeletonLogWriter::WriteSample(const SkeletonFrame& frame, XnUserID userId, int label)
+{
+	SkeletonLogRecord marker;
+	memset(&marker,0,sizeof(marker));
+	marker.timestamp=frame.timestamp;
+	marker.frameId=frame.frameId;
+	marker.sequence=frame.sequence;
+	marker.userId=userId;
+	marker.type=SKELETON_LOG_SAMPLE;
+	marker.label=label;
+	writer.Write(&marker,sizeof(marker));
+}
+
+/**
+ * Write anything buffered and close the file
+ */
+void SkeletonLogWriter::Close()
+{
+	writer.Close();
+}
+
+/**
+ * Constructor
+ */
+SkeletonLogReader::SkeletonLogReader()
+{
+	file=NULL;
+}
+
+/**
+ * Destructor
+ */
+SkeletonLogReader::~SkeletonLogReader()
+{
+	Close();
+}
+
+/**
+ * Is this file a skeleton log (as opposed to a text skeleton stream)
+ */
+bool SkeletonLogReader::IsSkeletonLog(const char* path)
+{
+	FILE* file = fopen(path,"rb");
+	if(file==NULL)
+	{
+		return false;
+	}
+	char magic[4];
+	bool isLog = fread(magic,1,4,file)==4 && memcmp(magic,SKELETON_LOG_MAGIC,4)==0;
+	fclose(file);
+	return isLog;
+}
+
+/**
+ * Open a log and check its header
+ */
+bool SkeletonLogReader::Open(const char* path)
+{
+	Close();
+	file=fopen(path,"rb");
+	if(file==NULL)
+	{
+		fprintf(stderr, "Can't open skeleton log %s\n", path);
+		return false;
+	}
+	// big reads, the file is consumed front to back
+	setvbuf(file,NULL,_IOFBF,1<<20);
+	if(fread(&header,sizeof(header),1,file)!=1 || memcmp(header.magic,SKELETON_LOG_MAGIC,4)!=0
+			|| header.version!=SKELETON_LOG_VERSION || header.recordSize!=sizeof(SkeletonLogRecord)
+			|| header.numJoints>SKELETON_LOG_NUM_JOINTS)
+	{
+		fprintf(stderr, "%s is not a version %d skeleton log\n", path, SKELETON_LOG_VERSION);
+		Close();
+		return false;
+	}
+	remap=false;
+	for(int i=0;i<SKELETON_LOG_NUM_JOINTS;i++)
+	{
+		jointMap[i]=-1;
+		for(int j=0;j<header.numJoints;j++)
+		{
+			if(header.joints[j]==SKELETON_LOG_JOINT_IDS[i])
+			{
+				jointMap[i]=j;
+			}
+		}
+		remap = remap || jointMap[i]!=i;
+	}
+	return true;
+}
+
+/**
+ * Close the file
+ */
+void SkeletonLogReader::Close()
+{
+	if(file!=NULL)
+	{
+		fclose(file);
+		file=NULL;
+	}
+}
+
+/**
+ * Read the next record
+ * @return false at the end of the log
+ */
+bool SkeletonLogReader::Read(SkeletonLogRecord& record)
+{
+	if(file==NULL || fread(&record,sizeof(record),1,file)!=1)
+	{
+		return false;
+	}
+	// put joints in our order if the log was written with a different list
+	if(remap)
+	{
+		SkeletonLogRecord raw = record;
+		for(int i=0;i<SKELETON_LOG_NUM_JOINTS;i++)
+		{
+			int j = jointMap[i];
+			record.confidence[i] = j>=0 ? raw.confidence[j] : 0;
+			for(int k=0;k<3;k++)
+			{
+				record.position[i][k] = j>=0 ? raw.position[j][k] : 0;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Go back to the first record
+ */
+void SkeletonLogReader::Rewind()
+{
+	if(file!=NULL)
+	{
+		fseek(file,sizeof(header),SEEK_SET);
+	}
+}
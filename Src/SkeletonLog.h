@@ -0,0 +1,121 @@
+/*************************************************
+ * SkeletonLog.h
+ *
+ * A compact binary log of raw skeleton data. Unlike the LIBSVM files
+ * written by KinectRecording (already windowed and made relative to the
+ * torso), a log keeps every tracked joint of every user with its
+ * confidence for every frame, so feature files with a different window
+ * length, joint set or normalization can be regenerated from it later
+ * (see LogToFeatures) without recording everyone again.
+ *
+ * Layout (native byte order):
+ *   SkeletonLogHeader
+ *   SkeletonLogRecord, SkeletonLogRecord, ...
+ *
+ * There is one SKELETON_LOG_JOINTS record per tracked user per frame, all
+ * records of a frame share the same sequence number. A SKELETON_LOG_SAMPLE
+ * record marks that a labeled sample of that user ended just before the
+ * frame with its sequence number. Markers are written by the recognition
+ * thread so they can land after records of later frames.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef SKELETON_LOG_H
+#define SKELETON_LOG_H
+
+#include "BackgroundWriter.h"
+#include "SkeletonFrame.h"
+#include <stdio.h>
+
+#define SKELETON_LOG_VERSION 1
+#define SKELETON_LOG_NUM_JOINTS 15
+
+/**
+ * Record types
+ */
+enum
+{
+	SKELETON_LOG_JOINTS = 0,
+	SKELETON_LOG_SAMPLE = 1,
+};
+
+struct SkeletonLogHeader
+{
+	char magic[4]; // "KSKL"
+	XnUInt16 version;
+	XnUInt16 numJoints;
+	XnUInt8 joints[16]; // XnSkeletonJoint stored in each position of a record
+	XnUInt32 recordSize;
+};
+
+struct SkeletonLogRecord
+{
+	XnUInt64 timestamp; // sensor timestamp (microseconds)
+	XnUInt32 frameId; // sensor frame number
+	XnUInt32 sequence; // frame number within the recording session
+	XnUInt16 userId;
+	XnUInt8 type; // SKELETON_LOG_JOINTS or SKELETON_LOG_SAMPLE
+	XnUInt8 reserved;
+	XnInt16 label; // class label of a SKELETON_LOG_SAMPLE marker
+	XnUInt8 confidence[SKELETON_LOG_NUM_JOINTS]; // fConfidence scaled to [0,255]
+	XnUInt8 padding[3];
+	XnFloat position[SKELETON_LOG_NUM_JOINTS][3];
+	XnUInt32 spare; // keeps the size a multiple of 8, always 0
+};
+
+/**
+ * The joints kept in a log, in record order (everything tracked by
+ * XN_SKEL_PROFILE_ALL)
+ */
+extern const XnSkeletonJoint SKELETON_LOG_JOINT_IDS[SKELETON_LOG_NUM_JOINTS];
+
+int SkeletonLogJointIndex(XnSkeletonJoint joint);
+int SkeletonLogJointIndex(const char* name);
+const char* SkeletonLogJointName(int index);
+
+int FetchSkeletonRecords(xn::UserGenerator& userGenerator, XnUInt32 sequence, SkeletonLogRecord* records, int maxRecords);
+void SkeletonFrameFromRecords(const SkeletonLogRecord* records, int nRecords, SkeletonFrame& frame);
+
+/**
+ * Appends records to a log from a background thread
+ */
+class SkeletonLogWriter
+{
+private:
+	BackgroundWriter writer;
+
+public:
+	bool Open(const char* path);
+	bool IsOpen() const;
+	void Write(const SkeletonLogRecord* records, int nRecords);
+	void WriteSample(const SkeletonFrame& frame, XnUserID userId, int label);
+	void Close();
+};
+
+/**
+ * Streams records out of a log
+ */
+class SkeletonLogReader
+{
+private:
+	FILE* file;
+	SkeletonLogHeader header;
+	int jointMap[SKELETON_LOG_NUM_JOINTS]; // file position of each of our joints, -1 if absent
+	bool remap; // the file's joint order differs from ours
+
+public:
+	SkeletonLogReader();
+	~SkeletonLogReader();
+	SkeletonLogReader(const SkeletonLogReader& other) = delete;
+	SkeletonLogReader& operator=(const SkeletonLogReader& other) = delete;
+
+	bool Open(const char* path);
+	void Close();
+	bool Read(SkeletonLogRecord& record);
+	void Rewind();
+
+	static bool IsSkeletonLog(const char* path);
+};
+
+#endif
@@ -0,0 +1,287 @@
+/******************************************************************************
+ * SkeletonSource.cpp
+ *
+ * Live (OpenNI) and recorded (file) sources of skeleton frames.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "SkeletonSource.h"
+#include <chrono>
+#include <thread>
+
+/**
+ * Capture function for GesturePipeline, pCookie is a SkeletonSource
+ */
+XnStatus SkeletonSource::Capture(void* pCookie, SkeletonFrame& frame)
+{
+	return ((SkeletonSource*)pCookie)->NextFrame(frame);
+}
+
+/**
+ * Constructor
+ * @param context an initialized context that is generating
+ * @param userGenerator the user generator to read skeletons from
+ */
+OpenNISkeletonSource::OpenNISkeletonSource(xn::Context* context, xn::UserGenerator* userGenerator)
+{
+	this->context=context;
+	this->userGenerator=userGenerator;
+	log=NULL;
+	sequence=0;
+	joints=SKELETON_ARM_JOINTS;
+}
+
+/**
+ * Which joints to read from OpenNI each frame, the torso and arms unless a
+ * recognizer needs more (e.g. FullBodyGestureRecognizer::JOINT_MASK).
+ * A log always gets every joint.
+ * @param joints bit per SkeletonJoint
+ */
+void OpenNISkeletonSource::SetJoints(XnUInt32 joints)
+{
+	this->joints=joints;
+}
+
+/**
+ * Also write every joint of every frame to a skeleton log
+ * @param log an open log, or NULL to stop logging
+ */
+void OpenNISkeletonSource::SetLog(SkeletonLogWriter* log)
+{
+	this->log=log;
+}
+
+/**
+ * Waits for the sensor and reads every tracked user
+ */
+XnStatus OpenNISkeletonSource::NextFrame(SkeletonFrame& frame)
+{
+	XnStatus nRetVal = context->WaitAndUpdateAll();
+	if(nRetVal != XN_STATUS_OK)
+	{
+		printf("WaitAndUpdateAll failed: %s\n", xnGetStatusString(nRetVal));
+		return nRetVal;
+	}
+	if(log==NULL)
+	{
+		nRetVal = FetchSkeletonFrame(*userGenerator, frame, joints);
+	}
+	else
+	{
+		// fetch every joint once, log it and take the recognition joints from it
+		int nRecords = FetchSkeletonRecords(*userGenerator, sequence, records, SKELETON_MAX_USERS);
+		log->Write(records, nRecords);
+		frame.timestamp = userGenerator->GetTimestamp();
+		frame.frameId = userGenerator->GetFrameID();
+		SkeletonFrameFromRecords(records, nRecords, frame);
+	}
+	frame.sequence = sequence++;
+	return nRetVal;
+}
+
+/**
+ * Constructor
+ * @param realTime true to return frames at the rate they were recorded,
+ * false to return them as fast as they can be read
+ */
+ReplaySkeletonSource::ReplaySkeletonSource(bool realTime)
+{
+	file=NULL;
+	binary=false;
+	hasPending=false;
+	sequence=0;
+	this->realTime=realTime;
+	started=false;
+	firstTimestamp=0;
+	startTime=0;
+}
+
+/**
+ * Destructor
+ */
+ReplaySkeletonSource::~ReplaySkeletonSource()
+{
+	Close();
+}
+
+/**
+ * Open a skeleton log or text skeleton stream
+ */
+bool ReplaySkeletonSource::Open(const char* path)
+{
+	Close();
+	started=false;
+	hasPending=false;
+	sequence=0;
+	binary=SkeletonLogReader::IsSkeletonLog(path);
+	if(binary)
+	{
+		return log.Open(path);
+	}
+	file=fopen(path,"r");
+	if(file==NULL)
+	{
+		fprintf(stderr, "Can't open skeleton stream %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Close the file
+ */
+void ReplaySkeletonSource::Close()
+{
+	log.Close();
+	if(file!=NULL)
+	{
+		fclose(file);
+		file=NULL;
+	}
+}
+
+/**
+ * Reads the next frame, waiting until it is due when playing in real time
+ * @return SKELETON_STATUS_EOF at the end of the file
+ */
+XnStatus ReplaySkeletonSource::NextFrame(SkeletonFrame& frame)
+{
+	bool read = binary ? ReadLogFrame(frame) : ReadTextFrame(frame);
+	if(!read)
+	{
+		return SKELETON_STATUS_EOF;
+	}
+	if(realTime)
+	{
+		WaitUntilDue(frame);
+	}
+	return XN_STATUS_OK;
+}
+
+/**
+ * Reads all joint records with the same sequence number from a skeleton
+ * log. Sample markers are skipped: they are written late, from the
+ * recognition thread and with an older frame's sequence number, so they
+ * must not start or end a frame.
+ */
+bool ReplaySkeletonSource::ReadLogFrame(SkeletonFrame& frame)
+{
+	SkeletonLogRecord record;
+	if(hasPending)
+	{
+		record=pending;
+		hasPending=false;
+	}
+	else if(!ReadLogJoints(record))
+	{
+		return false;
+	}
+	int nRecords = 0;
+	frame.timestamp=record.timestamp;
+	frame.frameId=record.frameId;
+	frame.sequence=record.sequence;
+	while(true)
+	{
+		if(nRecords<SKELETON_MAX_USERS)
+		{
+			records[nRecords++]=record;
+		}
+		if(!ReadLogJoints(record))
+		{
+			break;
+		}
+		if(record.sequence!=frame.sequence)
+		{
+			pending=record;
+			hasPending=true;
+			break;
+		}
+	}
+	SkeletonFrameFromRecords(records, nRecords, frame);
+	return true;
+}
+
+/**
+ * Reads the next SKELETON_LOG_JOINTS record, skipping any other kind
+ * @return false at the end of the log
+ */
+bool ReplaySkeletonSource::ReadLogJoints(SkeletonLogRecord& record)
+{
+	while(log.Read(record))
+	{
+		if(record.type==SKELETON_LOG_JOINTS)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Reads one frame from a text skeleton stream
+ */
+bool ReplaySkeletonSource::ReadTextFrame(SkeletonFrame& frame)
+{
+	unsigned long long timestamp;
+	unsigned int frameId;
+	int nUsers;
+	if(file==NULL || fscanf(file," F %llu %u %d",&timestamp,&frameId,&nUsers)!=3 || nUsers<0 || nUsers>SKELETON_MAX_USERS)
+	{
+		return false;
+	}
+	frame.timestamp=timestamp;
+	frame.frameId=frameId;
+	frame.sequence=sequence++;
+	frame.nUsers=nUsers;
+	for(int i=0;i<nUsers;i++)
+	{
+		UserSkeleton& user = frame.users[i];
+		unsigned int id;
+		if(fscanf(file,"%u",&id)!=1)
+		{
+			return false;
+		}
+		user.id=id;
+		// streams only have the torso and arms, and no confidence
+		user.validJoints=SKELETON_ARM_JOINTS;
+		for(int j=0;j<SKELETON_JOINT_LANES;j++)
+		{
+			user.x[j]=user.y[j]=user.z[j]=0.0f;
+		}
+		// joints are in SkeletonJoint order
+		for(int j=0;j<=SKELETON_RIGHT_HAND;j++)
+		{
+			if(fscanf(file,"%f %f %f",&user.x[j],&user.y[j],&user.z[j])!=3)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Sleeps until a frame is due relative to the first frame played
+ */
+void ReplaySkeletonSource::WaitUntilDue(const SkeletonFrame& frame)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	XnUInt64 nowUs = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+	if(!started)
+	{
+		started=true;
+		firstTimestamp=frame.timestamp;
+		startTime=nowUs;
+	}
+	// sensor timestamps are in microseconds
+	XnUInt64 due = startTime;
+	if(frame.timestamp>firstTimestamp)
+	{
+		due+=frame.timestamp-firstTimestamp;
+	}
+	if(due>nowUs)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(due-nowUs));
+	}
+}
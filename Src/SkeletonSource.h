@@ -0,0 +1,99 @@
+/*************************************************
+ * SkeletonSource.h
+ *
+ * Where skeleton frames come from. The recognition code only ever sees
+ * SkeletonFrames, so it can be driven either by the Kinect through OpenNI
+ * or by a recorded stream played back from a file. Playback does not need
+ * a sensor and can run in real time or as fast as possible, which makes
+ * runs repeatable for benchmarks and regression tests.
+ *
+ * Playback reads either a binary SkeletonLog (see SkeletonLog.h) or a
+ * plain text skeleton stream:
+ *   F <timestamp> <frameId> <nUsers>
+ *   <userId> <torso xyz> <leftShoulder xyz> <leftElbow xyz> <leftHand xyz>
+ *            <rightShoulder xyz> <rightElbow xyz> <rightHand xyz>
+ * with one user line per tracked user following each F line.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef SKELETON_SOURCE_H
+#define SKELETON_SOURCE_H
+
+#include "SkeletonFrame.h"
+#include "SkeletonLog.h"
+#include <stdio.h>
+
+/**
+ * Returned by NextFrame once a recording has been played to the end
+ */
+#define SKELETON_STATUS_EOF ((XnStatus)0x7FFF0001)
+
+class SkeletonSource
+{
+public:
+	virtual ~SkeletonSource() {}
+	/**
+	 * Blocks until the next frame is available and fills it in
+	 */
+	virtual XnStatus NextFrame(SkeletonFrame& frame) = 0;
+
+	static XnStatus Capture(void* pCookie, SkeletonFrame& frame);
+};
+
+/**
+ * Frames from a live sensor
+ */
+class OpenNISkeletonSource : public SkeletonSource
+{
+private:
+	xn::Context* context;
+	xn::UserGenerator* userGenerator;
+	SkeletonLogWriter* log;
+	XnUInt32 sequence;
+	XnUInt32 joints; // bit per SkeletonJoint read when not logging
+	SkeletonLogRecord records[SKELETON_MAX_USERS];
+
+public:
+	OpenNISkeletonSource(xn::Context* context, xn::UserGenerator* userGenerator);
+	void SetJoints(XnUInt32 joints);
+	void SetLog(SkeletonLogWriter* log);
+	XnStatus NextFrame(SkeletonFrame& frame);
+};
+
+/**
+ * Frames played back from a skeleton stream file
+ */
+class ReplaySkeletonSource : public SkeletonSource
+{
+private:
+	FILE* file;
+	SkeletonLogReader log;
+	bool binary;
+	SkeletonLogRecord records[SKELETON_MAX_USERS];
+	SkeletonLogRecord pending; // first joint record of the next frame
+	bool hasPending;
+	XnUInt32 sequence;
+	bool realTime;
+	bool started;
+	XnUInt64 firstTimestamp; // sensor time of the first frame
+	XnUInt64 startTime; // host time the first frame was returned
+
+public:
+	ReplaySkeletonSource(bool realTime);
+	~ReplaySkeletonSource();
+	ReplaySkeletonSource(const ReplaySkeletonSource& other) = delete;
+	ReplaySkeletonSource& operator=(const ReplaySkeletonSource& other) = delete;
+
+	bool Open(const char* path);
+	void Close();
+	XnStatus NextFrame(SkeletonFrame& frame);
+
+private:
+	bool ReadTextFrame(SkeletonFrame& frame);
+	bool ReadLogFrame(SkeletonFrame& frame);
+	bool ReadLogJoints(SkeletonLogRecord& record);
+	void WaitUntilDue(const SkeletonFrame& frame);
+};
+
+#endif
@@ -0,0 +1,193 @@
+/************************************************
+ * SpotBenchmark.cpp
+ *
+ * Measures what GestureSpotter gains on gestures performed at other speeds
+ * and what it costs. Every sample of a labeled LIBSVM file is replayed
+ * frame by frame, stretched in time to each duration (-d, 1 is as
+ * recorded), after the user stands still in its first pose. At the end of
+ * the gesture the recognizer's fixed window and the spotter's best scale
+ * are compared to the sample's label.
+ *
+ * The spotter's prediction at each scale is also checked against LIBSVM
+ * classifying the same time-normalized window, and timed against doing
+ * that for every scale, which is what separate recognizers per duration
+ * would cost.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ *
+ * Usage: ./SpotBenchmark <samples.txt> <model.txt> [-s frames]... [-d duration]...
+ * ********************************************/
+
+#include "GestureSpotter.h"
+#include "SampleReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+struct Sample
+{
+	int label;
+	std::vector<double> values; // every feature of the window
+};
+
+int main(int argc, char* argv[]) {
+	if(argc<3)
+	{
+		printf("Missing arguments\nUsage: ./SpotBenchmark <samples.txt> <model.txt> [-s frames]... [-d duration]...\n");
+		return -1;
+	}
+	GestureSpotter spotter(argv[2]);
+	GestureRecognizer recognizer(argv[2]);
+	std::vector<double> durations;
+	for(int i=3;i<argc;i+=2)
+	{
+		if(i+1<argc && strcmp(argv[i],"-s")==0)
+		{
+			if(!spotter.AddScale(atoi(argv[i+1])))
+			{
+				printf("Can't add a scale of %s frames\n",argv[i+1]);
+				return -1;
+			}
+		}
+		else if(i+1<argc && strcmp(argv[i],"-d")==0 && atof(argv[i+1])>0)
+		{
+			durations.push_back(atof(argv[i+1]));
+		}
+		else
+		{
+			printf("Unknown option %s\n",argv[i]);
+			return -1;
+		}
+	}
+	if(spotter.GetNumScales()==0)
+	{
+		// 0.75, 1 and 1.25 times as long as the recognizer's window
+		spotter.AddScale(GestureRecognizer::FRAMES*3/4);
+		spotter.AddScale(GestureRecognizer::FRAMES);
+		spotter.AddScale(GestureRecognizer::FRAMES*5/4);
+	}
+	if(durations.empty())
+	{
+		durations.push_back(0.75);
+		durations.push_back(1.0);
+		durations.push_back(1.25);
+	}
+
+	SampleReader input;
+	if(!input.Open(argv[1]))
+	{
+		return -1;
+	}
+	std::vector<Sample> samples;
+	Sample read;
+	read.values.resize(GestureRecognizer::FEATURES);
+	while(input.Read(read.label,read.values))
+	{
+		samples.push_back(read);
+	}
+	if(samples.empty())
+	{
+		printf("No samples in %s\n",argv[1]);
+		return -1;
+	}
+
+	int numScales=spotter.GetNumScales();
+	int sampleFrames=GestureRecognizer::WINDOW_FRAMES;
+	std::vector<struct svm_node> window(GestureRecognizer::FEATURES+1);
+	double spotSeconds=0.0, separateSeconds=0.0;
+	long frames=0, agree=0, checked=0;
+	UserSkeleton skeleton;
+	UserSkeleton still;
+	printf("Scales:");
+	for(int s=0;s<numScales;s++)
+	{
+		printf(" %d",spotter.GetScaleFrames(s));
+	}
+	printf(" frames, %d samples\n",(int)samples.size());
+	for(size_t d=0;d<durations.size();d++)
+	{
+		int length=(int)(sampleFrames*durations[d]+0.5);
+		int fixedCorrect=0, spotCorrect=0;
+		std::vector<int> scaleCorrect(numScales,0);
+		std::vector<int> scaleBest(numScales,0);
+		for(size_t n=0;n<samples.size();n++)
+		{
+			const Sample& sample=samples[n];
+			// long enough to clear the previous sample out of every window
+			GestureRecognizer::WindowFrame(&sample.values[0],sampleFrames-1,still);
+			for(int frame=0;frame<4*GestureRecognizer::FRAMES+sampleFrames;frame++)
+			{
+				recognizer.UpdateFeatures(still);
+				spotter.UpdateFeatures(still);
+			}
+			for(int frame=0;frame<length;frame++)
+			{
+				// the nearest recorded frame, the last one is the newest
+				int back=sampleFrames-(int)((frame+1)/durations[d]+0.5);
+				back=back<0 ? 0 : (back>sampleFrames-1 ? sampleFrames-1 : back);
+				GestureRecognizer::WindowFrame(&sample.values[0],back,skeleton);
+				recognizer.UpdateFeatures(skeleton);
+
+				clock_t start=clock();
+				spotter.UpdateFeatures(skeleton);
+				GestureSpot best=spotter.Spot();
+				spotSeconds+=(clock()-start)/(double)CLOCKS_PER_SEC;
+
+				start=clock();
+				int separate[SPOTTER_MAX_SCALES];
+				for(int s=0;s<numScales;s++)
+				{
+					spotter.GetWindow(s,&window[0]);
+					separate[s]=(int)svm_predict(spotter.GetModel(),&window[0]);
+				}
+				separateSeconds+=(clock()-start)/(double)CLOCKS_PER_SEC;
+				frames++;
+				for(int s=0;s<numScales;s++)
+				{
+					checked++;
+					if(spotter.SpotScale(s).label==separate[s])
+					{
+						agree++;
+					}
+				}
+
+				if(frame<length-1)
+				{
+					continue;
+				}
+				if(recognizer.Classify()==sample.label)
+				{
+					fixedCorrect++;
+				}
+				if(best.label==sample.label)
+				{
+					spotCorrect++;
+				}
+				for(int s=0;s<numScales;s++)
+				{
+					GestureSpot spot=spotter.SpotScale(s);
+					if(spot.label==sample.label)
+					{
+						scaleCorrect[s]++;
+					}
+					if(spot.frames==best.frames)
+					{
+						scaleBest[s]++;
+					}
+				}
+			}
+		}
+		int total=(int)samples.size();
+		printf("Duration %.2f (%d frames): fixed window %.1f%% correct, spotter %.1f%% correct\n",durations[d],length,
+				100.0*fixedCorrect/total,100.0*spotCorrect/total);
+		for(int s=0;s<numScales;s++)
+		{
+			printf("  scale %d frames: %.1f%% correct alone, best %.1f%% of the time\n",spotter.GetScaleFrames(s),
+					100.0*scaleCorrect[s]/total,100.0*scaleBest[s]/total);
+		}
+	}
+	printf("Same label as LIBSVM on the time-normalized window: %.2f%%\n",100.0*agree/checked);
+	printf("Spot: %.1f us per frame, separate windows: %.1f us per frame\n",1e6*spotSeconds/frames,1e6*separateSeconds/frames);
+	return 0;
+}
@@ -0,0 +1,141 @@
+/*************************************************
+ * SpscQueue.h
+ *
+ * A bounded lock-free queue for exactly one producer thread and one
+ * consumer thread. Used to hand skeleton frames from the capture thread to
+ * the recognition thread without either of them taking a lock.
+ *
+ * When the queue is full the producer can either give up (TryPush) or
+ * evict the oldest item (PushDropOldest). Producer and consumer both move
+ * head forward by CAS, so an item is either evicted or popped, never both.
+ * The consumer announces the item it is about to copy out (reading) before
+ * claiming it, and clears that once the copy is done. There is one slot more
+ * than the capacity, so the only slot the producer could reach while the
+ * consumer is still copying is that item's, and the producer waits for it.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <type_traits>
+
+template <class T>
+class SpscQueue
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SpscQueue items must be trivially copyable");
+private:
+	T* slots; // capacity+1 of them
+	size_t capacity;
+	std::atomic<size_t> head; // next item to read, only moved forward by CAS
+	std::atomic<size_t> tail; // next slot to write, only written by the producer
+	std::atomic<size_t> reading; // item the consumer is copying out plus 1, 0 if none
+
+	/**
+	 * Producer: write the slot at t and publish it, once the consumer is
+	 * done copying the item that was last in it
+	 */
+	void Publish(size_t t, const T& item)
+	{
+		size_t r;
+		while((r = reading.load(std::memory_order_acquire))!=0 && r-1+(capacity+1)==t)
+		{
+		}
+		slots[t%(capacity+1)] = item;
+		tail.store(t+1, std::memory_order_release);
+	}
+
+public:
+	/**
+	 * Constructor
+	 * @param capacity maximum number of items held at once
+	 */
+	SpscQueue(size_t capacity)
+	{
+		this->capacity = capacity>0 ? capacity : 1;
+		slots = new T[this->capacity+1];
+		head = 0;
+		tail = 0;
+		reading = 0;
+	}
+	~SpscQueue()
+	{
+		delete[] slots;
+	}
+	SpscQueue(const SpscQueue& other) = delete;
+	SpscQueue& operator=(const SpscQueue& other) = delete;
+
+	/**
+	 * Producer: add an item, fails if the queue is full
+	 */
+	bool TryPush(const T& item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if(t-head.load(std::memory_order_acquire) >= capacity)
+		{
+			return false;
+		}
+		Publish(t, item);
+		return true;
+	}
+
+	/**
+	 * Producer: add an item, evicting the oldest one if the queue is full
+	 * @return true if an item was dropped to make room
+	 */
+	bool PushDropOldest(const T& item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t h = head.load(std::memory_order_acquire);
+		bool dropped = false;
+		if(t-h >= capacity)
+		{
+			// if this fails the consumer just took the item, so there is room
+			dropped = head.compare_exchange_strong(h, h+1, std::memory_order_acq_rel);
+		}
+		Publish(t, item);
+		return dropped;
+	}
+
+	/**
+	 * Consumer: take the oldest item
+	 * @return false if the queue is empty
+	 */
+	bool TryPop(T& item)
+	{
+		size_t h = head.load(std::memory_order_acquire);
+		while(h != tail.load(std::memory_order_acquire))
+		{
+			// announce the item, then claim it so the producer can't evict it
+			reading.store(h+1, std::memory_order_seq_cst);
+			if(head.compare_exchange_strong(h, h+1, std::memory_order_seq_cst))
+			{
+				item = slots[h%(capacity+1)];
+				reading.store(0, std::memory_order_release);
+				return true;
+			}
+		}
+		reading.store(0, std::memory_order_release);
+		return false;
+	}
+
+	/**
+	 * Number of items waiting (approximate while the other thread is active)
+	 */
+	size_t Size() const
+	{
+		size_t t = tail.load(std::memory_order_acquire);
+		size_t h = head.load(std::memory_order_acquire);
+		return t>h ? t-h : 0;
+	}
+
+	size_t Capacity() const
+	{
+		return capacity;
+	}
+};
+
+#endif
@@ -0,0 +1,181 @@
+/************************************************
+ * StrideBenchmark.cpp
+ *
+ * Measures what predicting every few frames and smoothing the predictions
+ * cost in accuracy and save in CPU. Every sample of a labeled LIBSVM file
+ * is replayed frame by frame after a background sample (-n) from the same
+ * file, or without one after the user stands still in the sample's first
+ * pose, as one continuous stream. For each stride the recognizer is run
+ * without smoothing, with a majority vote and with averaged margins, each
+ * over the predictions of the last -w frames.
+ *
+ * Reports the reported gesture's accuracy at the end of every sample (where
+ * the window holds just the sample), how many frames into the sample it is
+ * first reported, how often it changes to a label that is neither the
+ * sample's nor the lead in's, and the cost per frame.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ *
+ * Usage: ./StrideBenchmark <samples.txt> <model.txt> [-n backgroundLabel] [-w frames] [-v voteFraction] [-m margin] [strides...]
+ * ********************************************/
+
+#include "GestureRecognizer.h"
+#include "SampleReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+struct Sample
+{
+	int label;
+	std::vector<double> values; // every feature of the window
+};
+
+int main(int argc, char* argv[]) {
+	if(argc<3)
+	{
+		printf("Missing arguments\nUsage: ./StrideBenchmark <samples.txt> <model.txt> [-n backgroundLabel] [-w frames] [-v voteFraction] [-m margin] [strides...]\n");
+		return -1;
+	}
+	int backgroundLabel=0;
+	int windowFrames=15;
+	double voteFraction=0.5;
+	double margin=0.0;
+	std::vector<int> strides;
+	for(int i=3;i<argc;i++)
+	{
+		if(i+1<argc && strcmp(argv[i],"-n")==0)
+		{
+			backgroundLabel=atoi(argv[++i]);
+		}
+		else if(i+1<argc && strcmp(argv[i],"-w")==0)
+		{
+			windowFrames=atoi(argv[++i]);
+		}
+		else if(i+1<argc && strcmp(argv[i],"-v")==0)
+		{
+			voteFraction=atof(argv[++i]);
+		}
+		else if(i+1<argc && strcmp(argv[i],"-m")==0)
+		{
+			margin=atof(argv[++i]);
+		}
+		else if(atoi(argv[i])>0)
+		{
+			strides.push_back(atoi(argv[i]));
+		}
+		else
+		{
+			printf("Unknown option %s\n",argv[i]);
+			return -1;
+		}
+	}
+	if(strides.empty())
+	{
+		int defaults[]={1,2,3,5,10};
+		strides.assign(defaults,defaults+5);
+	}
+	GestureRecognizer recognizer(argv[2]);
+
+	SampleReader input;
+	if(!input.Open(argv[1]))
+	{
+		return -1;
+	}
+	std::vector<Sample> samples;
+	std::vector<int> backgrounds;
+	Sample read;
+	read.values.resize(GestureRecognizer::FEATURES);
+	while(input.Read(read.label,read.values))
+	{
+		if(read.label==backgroundLabel)
+		{
+			backgrounds.push_back((int)samples.size());
+		}
+		samples.push_back(read);
+	}
+	if(samples.empty())
+	{
+		printf("No samples in %s\n",argv[1]);
+		return -1;
+	}
+
+	const char* names[]={"none","vote","score"};
+	int sampleFrames=GestureRecognizer::WINDOW_FRAMES;
+	int total=(int)samples.size();
+	UserSkeleton skeleton;
+	printf("%d samples, smoothing over %d frames, vote fraction %.2f, margin %.2f\n",total,windowFrames,voteFraction,margin);
+	for(size_t s=0;s<strides.size();s++)
+	{
+		for(int mode=SMOOTHING_NONE;mode<=SMOOTHING_SCORE;mode++)
+		{
+			int window=mode==SMOOTHING_NONE ? 1 : (windowFrames+strides[s]-1)/strides[s];
+			recognizer.SetStride(strides[s]);
+			recognizer.SetSmoothing((GestureSmoothing)mode,window,mode==SMOOTHING_VOTE ? voteFraction : margin);
+			int correct=0, reported=0;
+			long changes=0, spurious=0, frames=0, latency=0;
+			int nextBackground=0;
+			int last=0;
+			double seconds=0.0;
+			for(size_t n=0;n<samples.size();n++)
+			{
+				const Sample& sample=samples[n];
+				const Sample* leadIn=NULL;
+				for(size_t tries=0;tries<backgrounds.size() && leadIn==NULL;tries++)
+				{
+					int b=backgrounds[nextBackground++%backgrounds.size()];
+					if(b!=(int)n)
+					{
+						leadIn=&samples[b];
+					}
+				}
+				int reportedAt=-1;
+				for(int frame=0;frame<2*sampleFrames;frame++)
+				{
+					if(frame<sampleFrames)
+					{
+						GestureRecognizer::WindowFrame(&(leadIn!=NULL ? *leadIn : sample).values[0],
+								leadIn!=NULL ? sampleFrames-1-frame : sampleFrames-1,skeleton);
+					}
+					else
+					{
+						GestureRecognizer::WindowFrame(&sample.values[0],2*sampleFrames-1-frame,skeleton);
+					}
+					clock_t start=clock();
+					recognizer.UpdateFeatures(skeleton);
+					seconds+=(clock()-start)/(double)CLOCKS_PER_SEC;
+					frames++;
+					int gesture=recognizer.GetGesture();
+					if(gesture!=last)
+					{
+						changes++;
+						// neither the lead in nor the sample
+						if(gesture!=sample.label && (leadIn==NULL || gesture!=leadIn->label))
+						{
+							spurious++;
+						}
+						last=gesture;
+					}
+					if(frame>=sampleFrames && reportedAt<0 && gesture==sample.label)
+					{
+						reportedAt=frame-sampleFrames+1;
+					}
+				}
+				if(reportedAt>=0)
+				{
+					reported++;
+					latency+=reportedAt;
+				}
+				if(recognizer.GetGesture()==sample.label)
+				{
+					correct++;
+				}
+			}
+			printf("Stride %2d, %-5s (%2d predictions): %5.1f%% correct, first after %4.1f frames, %4.2f changes (%4.2f spurious) per sample, %5.1f us per frame\n",
+					strides[s],names[mode],window,100.0*correct/total,reported>0 ? latency/(double)reported : 0.0,
+					changes/(double)total,spurious/(double)total,1e6*seconds/frames);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,300 @@
+/************************************************
+ * TrainCascade.cpp
+ *
+ * Trains both stages of a cascade (GestureRecognizerBase::SetGate) from one
+ * labeled LIBSVM file. The full model is trained like Models/Model.txt:
+ * C-SVC with a degree 3 polynomial kernel and gamma of 1/features. The gate
+ * is a linear C-SVC of the background class against every gesture, folded
+ * into a single weight vector so it costs one dot product a frame however
+ * many support vectors it was trained with.
+ *
+ * The gate only rejects a window as background above a threshold, learned
+ * by cross validation: the highest background score a held out gesture got,
+ * plus a margin (-m). Any gesture the gate rejects is lost, so the training
+ * samples can't be used for this; the gate separates them all. The
+ * threshold is folded into the gate's rho, so the saved model rejects
+ * exactly when LIBSVM predicts the background label with it.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ *
+ * Usage: ./TrainCascade <samples.txt> <backgroundLabel> <outputPrefix> [-c cost] [-g gateCost] [-v folds] [-m margin]
+ *   Writes <outputPrefix>.txt (the full model) and <outputPrefix>.gate.txt
+ * ********************************************/
+
+#include "SampleReader.h"
+#include "svm.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static void Quiet(const char*)
+{
+}
+
+/**
+ * A linear model's decision function as one weight vector, the weights of
+ * the features 1 to weights.size()-1 (0 is unused), oriented so that
+ * background windows score above 0
+ */
+struct LinearGate
+{
+	std::vector<double> weights;
+	double rho;
+
+	double Score(const struct svm_node* x) const
+	{
+		double score=-rho;
+		for(;x->index!=-1;x++)
+		{
+			if(x->index<(int)weights.size())
+			{
+				score+=weights[x->index]*x->value;
+			}
+		}
+		return score;
+	}
+};
+
+/**
+ * Train a linear background against gesture model and fold it into weights
+ * @param samples only the ones marked in use are trained on
+ */
+static LinearGate TrainGate(const std::vector<std::vector<struct svm_node> >& samples, const std::vector<int>& labels,
+		const std::vector<bool>& use, int backgroundLabel, int numFeatures, const struct svm_parameter& param)
+{
+	std::vector<struct svm_node*> x;
+	std::vector<double> y;
+	for(size_t n=0;n<samples.size();n++)
+	{
+		if(use[n])
+		{
+			x.push_back(const_cast<struct svm_node*>(&samples[n][0]));
+			y.push_back(labels[n]==backgroundLabel ? 1.0 : -1.0);
+		}
+	}
+	struct svm_problem problem;
+	problem.l=(int)x.size();
+	problem.x=&x[0];
+	problem.y=&y[0];
+	struct svm_model* model=svm_train(&problem,&param);
+
+	LinearGate gate;
+	gate.weights.assign(numFeatures+1,0.0);
+	// LIBSVM scores its first label positive, which is whichever came first
+	double sign=model->label[0]==1 ? 1.0 : -1.0;
+	for(int i=0;i<model->l;i++)
+	{
+		for(const struct svm_node* sv=model->SV[i];sv->index!=-1;sv++)
+		{
+			if(sv->index<=numFeatures)
+			{
+				gate.weights[sv->index]+=sign*model->sv_coef[0][i]*sv->value;
+			}
+		}
+	}
+	gate.rho=sign*model->rho[0];
+	svm_free_and_destroy_model(&model);
+	return gate;
+}
+
+/**
+ * Save the gate as a LIBSVM model with the weight vector as its only support
+ * vector, labels the background label (positive) and 0 for any gesture
+ */
+static bool SaveGate(const char* path, const LinearGate& gate, int backgroundLabel, const struct svm_parameter& param)
+{
+	std::vector<struct svm_node> weights;
+	for(int i=1;i<(int)gate.weights.size();i++)
+	{
+		if(gate.weights[i]!=0.0)
+		{
+			struct svm_node node={i,gate.weights[i]};
+			weights.push_back(node);
+		}
+	}
+	struct svm_node end={-1,0.0};
+	weights.push_back(end);
+
+	struct svm_node* sv=&weights[0];
+	double coef=1.0;
+	double* coefs=&coef;
+	double rho=gate.rho;
+	int label[2]={backgroundLabel,0};
+	int nSV[2]={1,0};
+	struct svm_model model;
+	memset(&model,0,sizeof(model));
+	model.param=param;
+	model.nr_class=2;
+	model.l=1;
+	model.SV=&sv;
+	model.sv_coef=&coefs;
+	model.rho=&rho;
+	model.label=label;
+	model.nSV=nSV;
+	return svm_save_model(path,&model)==0;
+}
+
+int main(int argc, char* argv[]) {
+	if(argc<4)
+	{
+		printf("Missing arguments\nUsage: ./TrainCascade <samples.txt> <backgroundLabel> <outputPrefix> [-c cost] [-g gateCost] [-v folds] [-m margin]\n");
+		return -1;
+	}
+	int backgroundLabel=atoi(argv[2]);
+	double cost=1.0;
+	double gateCost=1.0;
+	int folds=5;
+	double margin=1.0;
+	for(int i=4;i<argc;i++)
+	{
+		if(i+1<argc && strcmp(argv[i],"-c")==0)
+		{
+			cost=atof(argv[++i]);
+		}
+		else if(i+1<argc && strcmp(argv[i],"-g")==0)
+		{
+			gateCost=atof(argv[++i]);
+		}
+		else if(i+1<argc && strcmp(argv[i],"-v")==0)
+		{
+			folds=atoi(argv[++i]);
+		}
+		else if(i+1<argc && strcmp(argv[i],"-m")==0)
+		{
+			margin=atof(argv[++i]);
+		}
+		else
+		{
+			printf("Unknown option %s\n",argv[i]);
+			return -1;
+		}
+	}
+	if(folds<2)
+	{
+		printf("Need at least 2 folds\n");
+		return -1;
+	}
+
+	SampleReader input;
+	if(!input.Open(argv[1]))
+	{
+		return -1;
+	}
+	std::vector<std::vector<struct svm_node> > samples;
+	std::vector<int> labels;
+	std::vector<struct svm_node> read;
+	int label;
+	int numFeatures=0;
+	int background=0;
+	while(input.Read(label,read))
+	{
+		for(size_t i=0;i+1<read.size();i++)
+		{
+			numFeatures=std::max(numFeatures,read[i].index);
+		}
+		background+=label==backgroundLabel ? 1 : 0;
+		samples.push_back(read);
+		labels.push_back(label);
+	}
+	int total=(int)samples.size();
+	if(background==0 || background==total)
+	{
+		printf("Need samples of both the background class %d and gestures\n",backgroundLabel);
+		return -1;
+	}
+	svm_set_print_string_function(Quiet);
+
+	struct svm_parameter param;
+	memset(&param,0,sizeof(param));
+	param.svm_type=C_SVC;
+	param.kernel_type=POLY;
+	param.degree=3;
+	param.gamma=1.0/numFeatures;
+	param.coef0=0.0;
+	param.cache_size=100;
+	param.C=cost;
+	param.eps=1e-3;
+	param.shrinking=1;
+	struct svm_parameter gateParam=param;
+	gateParam.kernel_type=LINEAR;
+	gateParam.C=gateCost;
+
+	// the full model on every sample
+	std::vector<struct svm_node*> x(total);
+	std::vector<double> y(total);
+	for(int n=0;n<total;n++)
+	{
+		x[n]=&samples[n][0];
+		y[n]=labels[n];
+	}
+	struct svm_problem problem;
+	problem.l=total;
+	problem.x=&x[0];
+	problem.y=&y[0];
+	const char* error=svm_check_parameter(&problem,&param);
+	if(error!=NULL)
+	{
+		printf("%s\n",error);
+		return -1;
+	}
+	struct svm_model* full=svm_train(&problem,&param);
+	std::string fullPath=std::string(argv[3])+".txt";
+	if(svm_save_model(fullPath.c_str(),full)!=0)
+	{
+		printf("Can't save %s\n",fullPath.c_str());
+		return -1;
+	}
+	printf("Full model: %d classes, %d support vectors, saved to %s\n",full->nr_class,full->l,fullPath.c_str());
+	svm_free_and_destroy_model(&full);
+
+	// score every sample with a gate that never saw it
+	std::vector<double> heldOut(total);
+	std::vector<bool> use(total);
+	for(int fold=0;fold<folds;fold++)
+	{
+		for(int n=0;n<total;n++)
+		{
+			use[n]=n%folds!=fold;
+		}
+		LinearGate gate=TrainGate(samples,labels,use,backgroundLabel,numFeatures,gateParam);
+		for(int n=fold;n<total;n+=folds)
+		{
+			heldOut[n]=gate.Score(&samples[n][0]);
+		}
+	}
+	double highestGesture=0.0;
+	bool anyGesture=false;
+	for(int n=0;n<total;n++)
+	{
+		if(labels[n]!=backgroundLabel && (!anyGesture || heldOut[n]>highestGesture))
+		{
+			highestGesture=heldOut[n];
+			anyGesture=true;
+		}
+	}
+	double threshold=highestGesture+margin;
+	int rejected=0;
+	for(int n=0;n<total;n++)
+	{
+		if(labels[n]==backgroundLabel && heldOut[n]>threshold)
+		{
+			rejected++;
+		}
+	}
+	printf("Gate threshold %.3f (%.3f above the highest held out gesture), rejects %d of %d held out background samples\n",
+			threshold,margin,rejected,background);
+
+	std::fill(use.begin(),use.end(),true);
+	LinearGate gate=TrainGate(samples,labels,use,backgroundLabel,numFeatures,gateParam);
+	gate.rho+=threshold;
+	std::string gatePath=std::string(argv[3])+".gate.txt";
+	if(!SaveGate(gatePath.c_str(),gate,backgroundLabel,gateParam))
+	{
+		printf("Can't save %s\n",gatePath.c_str());
+		return -1;
+	}
+	printf("Gate: 1 weight vector, saved to %s\n",gatePath.c_str());
+	return 0;
+}
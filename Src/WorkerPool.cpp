@@ -0,0 +1,150 @@
+/******************************************************************************
+ * WorkerPool.cpp
+ *
+ * A fixed set of worker threads used to fan out independent per-user work
+ * inside a single frame.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#include "WorkerPool.h"
+
+/**
+ * Constructor
+ * @param numThreads number of background threads to start. The thread
+ * calling Run also does work, so 0 runs everything inline.
+ */
+WorkerPool::WorkerPool(int numThreads)
+{
+	task=NULL;
+	cookie=NULL;
+	count=0;
+	nextIndex=0;
+	activeWorkers=0;
+	generation=0;
+	stopping=false;
+	for(int i=0;i<numThreads;i++)
+	{
+		threads.push_back(std::thread(&WorkerPool::WorkerLoop,this));
+	}
+}
+
+/**
+ * Destructor
+ * Wakes all workers and waits for them to exit
+ */
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping=true;
+	}
+	wake.notify_all();
+	for(size_t i=0;i<threads.size();i++)
+	{
+		threads[i].join();
+	}
+}
+
+/**
+ * Runs task(pCookie, i) for every i in [0,count) and waits for all of them
+ * to finish. Indices are handed out dynamically so a slow user does not hold
+ * up the others.
+ */
+void WorkerPool::Run(int count, Task task, void* pCookie)
+{
+	// not worth waking anyone up for a single item
+	if(threads.empty() || count<=1)
+	{
+		for(int i=0;i<count;i++)
+		{
+			task(pCookie,i);
+		}
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task=task;
+		this->cookie=pCookie;
+		this->count=count;
+		nextIndex=0;
+		activeWorkers=threads.size();
+		generation++;
+	}
+	wake.notify_all();
+	DoWork();
+	// join barrier: every worker has to check in before the batch is over
+	std::unique_lock<std::mutex> lock(mutex);
+	while(activeWorkers>0)
+	{
+		done.wait(lock);
+	}
+}
+
+/**
+ * Number of background threads (not counting the caller of Run)
+ */
+int WorkerPool::GetNumThreads() const
+{
+	return threads.size();
+}
+
+/**
+ * Picks a worker count for this machine: one less than the number of cores
+ * (the calling thread works too), capped at maxThreads
+ */
+int WorkerPool::DefaultThreadCount(int maxThreads)
+{
+	int cores = std::thread::hardware_concurrency();
+	int numThreads = cores-1;
+	if(numThreads>maxThreads)
+	{
+		numThreads=maxThreads;
+	}
+	if(numThreads<0)
+	{
+		numThreads=0;
+	}
+	return numThreads;
+}
+
+/**
+ * Claims indices until the current batch is exhausted
+ */
+void WorkerPool::DoWork()
+{
+	int index;
+	while((index=nextIndex.fetch_add(1))<count)
+	{
+		task(cookie,index);
+	}
+}
+
+/**
+ * Body of each background thread
+ */
+void WorkerPool::WorkerLoop()
+{
+	unsigned int seen=0;
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while(!stopping && generation==seen)
+			{
+				wake.wait(lock);
+			}
+			if(stopping)
+			{
+				return;
+			}
+			seen=generation;
+		}
+		DoWork();
+		std::lock_guard<std::mutex> lock(mutex);
+		if(--activeWorkers==0)
+		{
+			done.notify_one();
+		}
+	}
+}
@@ -0,0 +1,58 @@
+/*************************************************
+ * WorkerPool.h
+ *
+ * A fixed set of worker threads used to fan out independent per-user work
+ * (feature updates and classification) inside a single frame.
+ *
+ * Run() hands out the indices [0,count) to the workers and the calling
+ * thread, and only returns once every index has been processed, so it acts
+ * as a join barrier for the frame.
+ *
+ * Author: Aaron Pulver <atp1317@rit.edu>
+ * **************************************************************************/
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+	/**
+	 * A unit of work, called once for every index passed to Run
+	 */
+	typedef void (*Task)(void* pCookie, int index);
+
+private:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake; // signalled when a new batch is posted
+	std::condition_variable done; // signalled when the last worker finishes
+	Task task;
+	void* cookie;
+	int count;
+	std::atomic<int> nextIndex;
+	int activeWorkers;
+	unsigned int generation;
+	bool stopping;
+
+	void WorkerLoop();
+	void DoWork();
+
+public:
+	WorkerPool(int numThreads);
+	~WorkerPool();
+	WorkerPool(const WorkerPool& other) = delete;
+	WorkerPool& operator=(const WorkerPool& other) = delete;
+
+	void Run(int count, Task task, void* pCookie);
+	int GetNumThreads() const;
+	static int DefaultThreadCount(int maxThreads);
+};
+
+#endif
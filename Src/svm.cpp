@@ -7,6 +7,7 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <locale.h>
+#include <vector>
 #include "svm.h"
 int libsvm_version = LIBSVM_VERSION;
 typedef float Qfloat;
@@ -38,6 +39,22 @@ static inline double powi(double base, int times)
 #define TAU 1e-12
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type))
 
+// Scratch space for predicting, one per thread so svm_predict,
+// svm_predict_values and svm_predict_probability allocate nothing once it
+// has grown to the largest model the thread has used
+struct predict_workspace
+{
+	std::vector<double> kvalue;
+	std::vector<int> start;
+	std::vector<int> vote;
+	std::vector<char> computed; // kernel values svm_predict_ddag_values has
+	std::vector<double> dec_values;
+	std::vector<double> pairwise_prob; // nr_class x nr_class, row major
+	std::vector<double> Q; // nr_class x nr_class, row major
+	std::vector<double> Qp;
+};
+static thread_local predict_workspace workspace;
+
 static void print_string_stdout(const char *s)
 {
 	fputs(s,stdout);
@@ -1820,34 +1837,37 @@ static double sigmoid_predict(double decision_value, double A, double B)
 	double fApB = decision_value*A+B;
 	// 1-p used later; avoid catastrophic cancellation
 	if (fApB >= 0)
-		return exp(-fApB)/(1.0+exp(-fApB));
+	{
+		double e = exp(-fApB);
+		return e/(1.0+e);
+	}
 	else
 		return 1.0/(1+exp(fApB)) ;
 }
 
 // Method 2 from the multiclass_prob paper by Wu, Lin, and Weng
-static void multiclass_probability(int k, double **r, double *p)
+// r, Q: k x k row major, Q and Qp: scratch space for k x k and k values.
+// The rows are contiguous so the inner loops vectorize.
+static void multiclass_probability(int k, const double *r, double *p, double *Q, double *Qp)
 {
 	int t,j;
 	int iter = 0, max_iter=max(100,k);
-	double **Q=Malloc(double *,k);
-	double *Qp=Malloc(double,k);
 	double pQp, eps=0.005/k;
 	
 	for (t=0;t<k;t++)
 	{
+		double *Qt=&Q[t*k];
 		p[t]=1.0/k;  // Valid if k = 1
-		Q[t]=Malloc(double,k);
-		Q[t][t]=0;
+		Qt[t]=0;
 		for (j=0;j<t;j++)
 		{
-			Q[t][t]+=r[j][t]*r[j][t];
-			Q[t][j]=Q[j][t];
+			Qt[t]+=r[j*k+t]*r[j*k+t];
+			Qt[j]=Q[j*k+t];
 		}
 		for (j=t+1;j<k;j++)
 		{
-			Q[t][t]+=r[j][t]*r[j][t];
-			Q[t][j]=-r[j][t]*r[t][j];
+			Qt[t]+=r[j*k+t]*r[j*k+t];
+			Qt[j]=-r[j*k+t]*r[t*k+j];
 		}
 	}
 	for (iter=0;iter<max_iter;iter++)
@@ -1856,37 +1876,35 @@ static void multiclass_probability(int k, double **r, double *p)
 		pQp=0;
 		for (t=0;t<k;t++)
 		{
-			Qp[t]=0;
+			const double *Qt=&Q[t*k];
+			double sum=0;
 			for (j=0;j<k;j++)
-				Qp[t]+=Q[t][j]*p[j];
-			pQp+=p[t]*Qp[t];
-		}
-		double max_error=0;
-		for (t=0;t<k;t++)
-		{
-			double error=fabs(Qp[t]-pQp);
-			if (error>max_error)
-				max_error=error;
-		}
-		if (max_error<eps) break;
+				sum+=Qt[j]*p[j];
+			Qp[t]=sum;
+			pQp+=p[t]*sum;
+		}
+		// done once every class is within eps, stops at the first that isn't
+		bool converged=true;
+		for (t=0;t<k && converged;t++)
+			converged=fabs(Qp[t]-pQp)<eps;
+		if (converged) break;
 		
 		for (t=0;t<k;t++)
 		{
-			double diff=(-Qp[t]+pQp)/Q[t][t];
+			const double *Qt=&Q[t*k];
+			double diff=(-Qp[t]+pQp)/Qt[t];
 			p[t]+=diff;
-			pQp=(pQp+diff*(diff*Q[t][t]+2*Qp[t]))/(1+diff)/(1+diff);
+			pQp=(pQp+diff*(diff*Qt[t]+2*Qp[t]))/(1+diff)/(1+diff);
+			double scale=1/(1+diff);
 			for (j=0;j<k;j++)
 			{
-				Qp[j]=(Qp[j]+diff*Q[t][j])/(1+diff);
-				p[j]/=(1+diff);
+				Qp[j]=(Qp[j]+diff*Qt[j])*scale;
+				p[j]*=scale;
 			}
 		}
 	}
 	if (iter>=max_iter)
 		info("Exceeds max_iter in multiclass_prob\n");
-	for(t=0;t<k;t++) free(Q[t]);
-	free(Q);
-	free(Qp);
 }
 
 // Cross-validation decision values for probability estimates
@@ -2522,16 +2540,19 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 		int nr_class = model->nr_class;
 		int l = model->l;
 		
-		double *kvalue = Malloc(double,l);
+		workspace.kvalue.resize(l);
+		workspace.start.resize(nr_class);
+		workspace.vote.resize(nr_class);
+		double *kvalue = &workspace.kvalue[0];
 		for(i=0;i<l;i++)
 			kvalue[i] = Kernel::k_function(x,model->SV[i],model->param);
 
-		int *start = Malloc(int,nr_class);
+		int *start = &workspace.start[0];
 		start[0] = 0;
 		for(i=1;i<nr_class;i++)
 			start[i] = start[i-1]+model->nSV[i-1];
 
-		int *vote = Malloc(int,nr_class);
+		int *vote = &workspace.vote[0];
 		for(i=0;i<nr_class;i++)
 			vote[i] = 0;
 
@@ -2567,9 +2588,6 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 			if(vote[i] > vote[vote_max_idx])
 				vote_max_idx = i;
 
-		free(kvalue);
-		free(start);
-		free(vote);
 		return model->label[vote_max_idx];
 	}
 }
@@ -2577,16 +2595,96 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 double svm_predict(const svm_model *model, const svm_node *x)
 {
 	int nr_class = model->nr_class;
-	double *dec_values;
 	if(model->param.svm_type == ONE_CLASS ||
 	   model->param.svm_type == EPSILON_SVR ||
 	   model->param.svm_type == NU_SVR)
-		dec_values = Malloc(double, 1);
+		workspace.dec_values.resize(1);
 	else 
-		dec_values = Malloc(double, nr_class*(nr_class-1)/2);
-	double pred_result = svm_predict_values(model, x, dec_values);
-	free(dec_values);
-	return pred_result;
+		workspace.dec_values.resize(nr_class*(nr_class-1)/2);
+	return svm_predict_values(model, x, &workspace.dec_values[0]);
+}
+
+// Decision DAG: k-1 pairwise decisions instead of k(k-1)/2. The first and
+// last classes still in contention are compared and the loser drops out.
+// Kernel values are only computed for the SVs a decision has a nonzero
+// coefficient for, each at most once. dec_values of decisions the DAG
+// never reached are set to 0.
+double svm_predict_ddag_values(const svm_model *model, const svm_node *x, double* dec_values)
+{
+	if(model->param.svm_type == ONE_CLASS ||
+	   model->param.svm_type == EPSILON_SVR ||
+	   model->param.svm_type == NU_SVR)
+		return svm_predict_values(model, x, dec_values);
+
+	int i;
+	int nr_class = model->nr_class;
+	int l = model->l;
+
+	workspace.kvalue.resize(l);
+	workspace.computed.assign(l,0);
+	workspace.start.resize(nr_class);
+	double *kvalue = &workspace.kvalue[0];
+	char *computed = &workspace.computed[0];
+
+	int *start = &workspace.start[0];
+	start[0] = 0;
+	for(i=1;i<nr_class;i++)
+		start[i] = start[i-1]+model->nSV[i-1];
+
+	for(i=0;i<nr_class*(nr_class-1)/2;i++)
+		dec_values[i] = 0;
+
+	int first = 0;
+	int last = nr_class-1;
+	while(first<last)
+	{
+		int p = first*(2*nr_class-first-1)/2+(last-first-1);
+		double sum = 0;
+		int k;
+		double *coef1 = model->sv_coef[last-1];
+		double *coef2 = model->sv_coef[first];
+		for(k=start[first];k<start[first]+model->nSV[first];k++)
+			if(coef1[k] != 0)
+			{
+				if(!computed[k])
+				{
+					kvalue[k] = Kernel::k_function(x,model->SV[k],model->param);
+					computed[k] = 1;
+				}
+				sum += coef1[k] * kvalue[k];
+			}
+		for(k=start[last];k<start[last]+model->nSV[last];k++)
+			if(coef2[k] != 0)
+			{
+				if(!computed[k])
+				{
+					kvalue[k] = Kernel::k_function(x,model->SV[k],model->param);
+					computed[k] = 1;
+				}
+				sum += coef2[k] * kvalue[k];
+			}
+		sum -= model->rho[p];
+		dec_values[p] = sum;
+
+		if(sum > 0)
+			--last;
+		else
+			++first;
+	}
+
+	return model->label[first];
+}
+
+double svm_predict_ddag(const svm_model *model, const svm_node *x)
+{
+	int nr_class = model->nr_class;
+	if(model->param.svm_type == ONE_CLASS ||
+	   model->param.svm_type == EPSILON_SVR ||
+	   model->param.svm_type == NU_SVR)
+		workspace.dec_values.resize(1);
+	else 
+		workspace.dec_values.resize(nr_class*(nr_class-1)/2);
+	return svm_predict_ddag_values(model, x, &workspace.dec_values[0]);
 }
 
 double svm_predict_probability(
@@ -2597,31 +2695,29 @@ double svm_predict_probability(
 	{
 		int i;
 		int nr_class = model->nr_class;
-		double *dec_values = Malloc(double, nr_class*(nr_class-1)/2);
+		workspace.dec_values.resize(nr_class*(nr_class-1)/2);
+		workspace.pairwise_prob.resize(nr_class*nr_class);
+		workspace.Q.resize(nr_class*nr_class);
+		workspace.Qp.resize(nr_class);
+		double *dec_values = &workspace.dec_values[0];
 		svm_predict_values(model, x, dec_values);
 
 		double min_prob=1e-7;
-		double **pairwise_prob=Malloc(double *,nr_class);
-		for(i=0;i<nr_class;i++)
-			pairwise_prob[i]=Malloc(double,nr_class);
+		double *pairwise_prob=&workspace.pairwise_prob[0];
 		int k=0;
 		for(i=0;i<nr_class;i++)
 			for(int j=i+1;j<nr_class;j++)
 			{
-				pairwise_prob[i][j]=min(max(sigmoid_predict(dec_values[k],model->probA[k],model->probB[k]),min_prob),1-min_prob);
-				pairwise_prob[j][i]=1-pairwise_prob[i][j];
+				pairwise_prob[i*nr_class+j]=min(max(sigmoid_predict(dec_values[k],model->probA[k],model->probB[k]),min_prob),1-min_prob);
+				pairwise_prob[j*nr_class+i]=1-pairwise_prob[i*nr_class+j];
 				k++;
 			}
-		multiclass_probability(nr_class,pairwise_prob,prob_estimates);
+		multiclass_probability(nr_class,pairwise_prob,prob_estimates,&workspace.Q[0],&workspace.Qp[0]);
 
 		int prob_max_idx = 0;
 		for(i=1;i<nr_class;i++)
 			if(prob_estimates[i] > prob_estimates[prob_max_idx])
 				prob_max_idx = i;
-		for(i=0;i<nr_class;i++)
-			free(pairwise_prob[i]);
-		free(dec_values);
-		free(pairwise_prob);	     
 		return model->label[prob_max_idx];
 	}
 	else 
@@ -87,6 +87,8 @@ double svm_get_svr_probability(const struct svm_model *model);
 double svm_predict_values(const struct svm_model *model, const struct svm_node *x, double* dec_values);
 double svm_predict(const struct svm_model *model, const struct svm_node *x);
 double svm_predict_probability(const struct svm_model *model, const struct svm_node *x, double* prob_estimates);
+double svm_predict_ddag_values(const struct svm_model *model, const struct svm_node *x, double* dec_values);
+double svm_predict_ddag(const struct svm_model *model, const struct svm_node *x);
 
 void svm_free_model_content(struct svm_model *model_ptr);
 void svm_free_and_destroy_model(struct svm_model **model_ptr_ptr);